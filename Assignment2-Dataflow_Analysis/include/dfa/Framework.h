@@ -78,6 +78,8 @@ private:
 protected:
   // Domain
   std::vector<TDomainElem> Domain;
+  // Domain Element-Position Mapping, for constant-time lookups
+  std::unordered_map<TDomainElem, size_t> DomainIdxMap;
   // Instruction-Domain Value Mapping
   std::unordered_map<const Instruction *, DomainVal_t> InstDomainValMap;
   /*****************************************************************************
@@ -163,11 +165,23 @@ protected:
   // because Variable(...) takes a "const Value *const" as parameter (here serve as TDomainelem)
   // see https://www.youtube.com/watch?v=4fJBrditnJU for more explanations 
   int getPos(const TDomainElem &E) const {
-  	auto it = std::find(Domain.begin(), Domain.end(), E);
-  	if (it == Domain.end())
+  	auto it = DomainIdxMap.find(E);
+  	if (it == DomainIdxMap.end())
   		return -1;
   	else
-  		return std::distance(Domain.begin(), it);
+  		return it->second;
+  }
+
+  /**
+   * @brief  Append @c E to the domain, unless it is already part of it.
+   * @return true if @c E has been appended, false otherwise
+   */
+  bool insertDomainElem(const TDomainElem &E) {
+    if (!DomainIdxMap.emplace(E, Domain.size()).second) {
+      return false;
+    }
+    Domain.push_back(E);
+    return true;
   }
   
   /**
@@ -319,6 +333,10 @@ protected:
   virtual ~Framework() {}
 
   bool runOnFunction(const Function &F) {
+    // discard the results of the previously analyzed function
+    Domain.clear();
+    DomainIdxMap.clear();
+    InstDomainValMap.clear();
     // initialize the domain
     initializeDomain(F);
     // apply the initial conditions
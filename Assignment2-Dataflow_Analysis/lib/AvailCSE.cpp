@@ -0,0 +1,154 @@
+/**
+ * @file Available-Expression-Driven Common Subexpression Elimination
+ */
+#include <llvm/ADT/Statistic.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/Transforms/Utils/SSAUpdater.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "AvailExpr.h"
+
+#define DEBUG_TYPE "avail-cse"
+
+STATISTIC(NumAvailCSE, "Number of binary operators eliminated by avail-cse");
+STATISTIC(NumAvailCSEPhis, "Number of phis inserted by avail-cse");
+
+namespace {
+
+/**
+ * @brief Common subexpression elimination driven by @c AvailExprImpl .
+ *
+ * A binary operator whose expression is available right before it is
+ * recomputing a value that every path has already computed. It is replaced
+ * with the earlier computation, or with a phi of the earlier computations
+ * when the expression becomes available through several paths.
+ */
+class AvailCSE final : public FunctionPass {
+private:
+  /**
+   * @brief Eliminate the redundant computations of one expression.
+   *
+   * @param Computations  All the (reachable) computations of the expression,
+   *                      in program order within each basic block
+   * @param Repls         Replacement of each redundant computation
+   */
+  void eliminate(const Expression &Expr,
+                 const std::vector<BinaryOperator *> &Computations,
+                 const AvailExprImpl &AE,
+                 std::unordered_map<Value *, Value *> &Repls) {
+    std::vector<BinaryOperator *> Redundant;
+    for (BinaryOperator *const BinaryOp : Computations) {
+      if (AE.isAvailable(Expr, *BinaryOp)) {
+        Redundant.push_back(BinaryOp);
+      }
+    }
+    if (Redundant.empty()) {
+      return;
+    }
+
+    SmallVector<PHINode *, 8> InsertedPHIs;
+    SSAUpdater SSA(&InsertedPHIs);
+    SSA.Initialize(Computations.front()->getType(),
+                   Computations.front()->getName());
+    // The value available at the end of each basic block is its last
+    // computation of the expression.
+    for (BinaryOperator *const BinaryOp : Computations) {
+      SSA.AddAvailableValue(BinaryOp->getParent(), BinaryOp);
+    }
+    for (BinaryOperator *const BinaryOp : Redundant) {
+      BinaryOperator *PrevComputation = nullptr;
+      for (BinaryOperator *const Computation : Computations) {
+        if (Computation == BinaryOp) {
+          break;
+        }
+        if (Computation->getParent() == BinaryOp->getParent()) {
+          PrevComputation = Computation;
+        }
+      }
+      Repls[BinaryOp] =
+          PrevComputation
+              ? static_cast<Value *>(PrevComputation)
+              : SSA.GetValueInMiddleOfBlock(BinaryOp->getParent());
+      // The surviving computations may only keep the poison-generating
+      // flags that the eliminated ones carry as well.
+      for (BinaryOperator *const Computation : Computations) {
+        Computation->andIRFlags(BinaryOp);
+      }
+    }
+    NumAvailCSEPhis += InsertedPHIs.size();
+  }
+
+public:
+  static char ID;
+
+  AvailCSE() : FunctionPass(ID) {}
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<AvailExprWrapperPass>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  virtual bool runOnFunction(Function &F) override {
+    errs() << "* Available-Expression CSE *"
+           << "\n";
+    const AvailExprImpl &AE =
+        getAnalysis<AvailExprWrapperPass>().getAvailExpr();
+    const DominatorTree &DT =
+        getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+
+    // Group the computations by expression. Unreachable basic blocks are left
+    // alone, as every expression is vacuously available in them.
+    std::unordered_map<Expression, std::vector<BinaryOperator *>> ExprComps;
+    std::vector<Expression> ExprOrder;
+    for (BasicBlock &BB : F) {
+      if (!DT.isReachableFromEntry(&BB)) {
+        continue;
+      }
+      for (Instruction &Inst : BB) {
+        BinaryOperator *const BinaryOp = dyn_cast<BinaryOperator>(&Inst);
+        if (!BinaryOp) {
+          continue;
+        }
+        auto ExprCompsIt = ExprComps.find(Expression(*BinaryOp));
+        if (ExprCompsIt == ExprComps.end()) {
+          ExprOrder.push_back(Expression(*BinaryOp));
+          ExprCompsIt = ExprComps.emplace(Expression(*BinaryOp),
+                                          std::vector<BinaryOperator *>())
+                            .first;
+        }
+        ExprCompsIt->second.push_back(BinaryOp);
+      }
+    }
+
+    std::unordered_map<Value *, Value *> Repls;
+    for (const Expression &Expr : ExprOrder) {
+      eliminate(Expr, ExprComps.at(Expr), AE, Repls);
+    }
+    // A replacement may itself be eliminated, hence follow the chain to the
+    // surviving value before rewriting the uses.
+    for (auto &ReplPair : Repls) {
+      Value *Repl = ReplPair.second;
+      for (auto ReplIt = Repls.find(Repl); ReplIt != Repls.end();
+           ReplIt = Repls.find(Repl)) {
+        Repl = ReplIt->second;
+      }
+      ReplPair.first->replaceAllUsesWith(Repl);
+    }
+    for (auto &ReplPair : Repls) {
+      cast<Instruction>(ReplPair.first)->eraseFromParent();
+    }
+
+    errs() << "Eliminated " << Repls.size() << " expression(s) in "
+           << F.getName() << "\n";
+    NumAvailCSE += Repls.size();
+    return !Repls.empty();
+  }
+};
+
+char AvailCSE::ID = 0;
+RegisterPass<AvailCSE> X("avail-cse", "Available-Expression CSE");
+
+} // anonymous namespace
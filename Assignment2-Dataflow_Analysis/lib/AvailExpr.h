@@ -0,0 +1,130 @@
+#pragma once // NOLINT(llvm-header-guard)
+
+/**
+ * @file Available Expression Dataflow Analysis
+ */
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Pass.h>
+
+#include <dfa/Framework.h>
+#include <dfa/MeetOp.h>
+
+#include "Expression.h"
+using namespace dfa;
+using namespace llvm;
+
+class AvailExprWrapperPass;
+
+using AvailExprFrameworkBase =
+    Framework<Expression, bool, Direction::kForward, Intersect>;
+
+class AvailExprImpl final : public AvailExprFrameworkBase {
+private:
+  friend class AvailExprWrapperPass;
+
+  // Domain value at the entry of each basic block, cached after the analysis
+  // has converged so that queries do not need to re-apply the meet operator.
+  std::unordered_map<const BasicBlock *, DomainVal_t> BoundaryVals;
+
+  virtual void initializeDomainFromInst(const Instruction &Inst) override {
+	if (const BinaryOperator *const BinaryOp =
+            dyn_cast<BinaryOperator>(&Inst)) {
+      /**
+       * @todo(cscd70) Please complete the construction of domain.
+       */
+	  // note: Expression(const BinaryOperator &BinaryOp)  
+	  insertDomainElem(Expression(*BinaryOp));
+    }
+  }
+  virtual bool transferFunc(const Instruction &Inst, const DomainVal_t &IBV,
+                            DomainVal_t &OBV) override {
+    /**
+     * @todo(cscd70) Please complete the definition of the transfer function.
+     */
+
+	/*
+	errs() << "  IBV: ";
+	for (const auto& v : IBV) {
+		errs() << v << "\t";
+	}
+	errs() << "\n";
+	*/	
+
+	DomainVal_t tmpBV = IBV;
+
+	// kill set
+	// Every instruction that defines a value kills the expressions using it,
+	// not only the binary operations: a phi at a loop header redefines its
+	// value on each iteration.
+	const Value *I = &Inst;
+	
+	for (size_t i = 0; i < Domain.size(); i++) {
+		if (I == Domain[i].LHS || I == Domain[i].RHS) {
+			tmpBV[i] = false;
+		}
+	}
+
+	// gen set
+	// only binary operations generate expressions in this assignment
+	if (const BinaryOperator *const BinaryOp = dyn_cast<BinaryOperator>(&Inst))
+		tmpBV[getPos(*BinaryOp)] = true;
+
+	// check whether output OBV has been changed
+	bool change = (OBV != tmpBV);
+	if(change)
+		OBV = tmpBV;	
+    return change;
+  }
+
+public:
+  bool runOnFunction(const Function &F) {
+    BoundaryVals.clear();
+    bool Changed = AvailExprFrameworkBase::runOnFunction(F);
+    for (const BasicBlock &BB : F) {
+      BoundaryVals.emplace(&BB, getBoundaryVal(BB));
+    }
+    return Changed;
+  }
+
+  /**
+   * @brief  Query whether @c Expr is available right before @c Inst .
+   *
+   * Both the domain position and the domain value are looked up in hash
+   * tables, hence the query takes constant time.
+   */
+  bool isAvailable(const Expression &Expr, const Instruction &Inst) const {
+    int Pos = getPos(Expr);
+    if (Pos == -1) {
+      return false;
+    }
+    if (const Instruction *const PrevInst = Inst.getPrevNode()) {
+      return InstDomainValMap.at(PrevInst)[Pos];
+    }
+    return BoundaryVals.at(Inst.getParent())[Pos];
+  }
+};
+
+class AvailExprWrapperPass : public FunctionPass {
+private:
+  AvailExprImpl AvailExpr;
+
+public:
+  static char ID;
+
+  AvailExprWrapperPass() : FunctionPass(ID) {}
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.setPreservesAll();
+  }
+  bool runOnFunction(Function &F) override {
+    return AvailExpr.runOnFunction(F);
+  }
+
+  /**
+   * @brief Obtain the analysis results, to be queried via
+   *        @c AvailExprImpl::isAvailable .
+   */
+  const AvailExprImpl &getAvailExpr() const { return AvailExpr; }
+};
@@ -0,0 +1,140 @@
+/**
+ * @file Dominator-Scoped Common Subexpression Elimination
+ */
+#include <llvm/ADT/Statistic.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instruction.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "Expression.h"
+
+#define DEBUG_TYPE "dom-cse"
+
+using namespace llvm;
+
+STATISTIC(NumDomCSE, "Number of binary operators eliminated by dom-cse");
+
+namespace {
+
+/**
+ * @brief Common subexpression elimination over the dominator tree.
+ *
+ * A binary operator is fully redundant if an identical expression is computed
+ * by one of its dominators. Walking the dominator tree in preorder with a
+ * scoped hash table finds all of them in a single pass, without the fixpoint
+ * iteration of the available expression analysis.
+ */
+class DomCSE final : public FunctionPass {
+private:
+  /// Expressions computed along the current dominator tree path, mapped to
+  /// the instruction that computes them.
+  std::unordered_map<Expression, Instruction *> AvailExprs;
+
+  /**
+   * @brief A dominator tree node on the DFS stack, together with the
+   *        expressions that its basic block has made available.
+   */
+  struct Scope {
+    const DomTreeNode *const Node;
+    DomTreeNode::const_iterator NextChild;
+    std::vector<Expression> Exprs;
+    explicit Scope(const DomTreeNode *const Node)
+        : Node(Node), NextChild(Node->begin()) {}
+  };
+
+  /**
+   * @brief Canonicalize the expression of @c BinaryOp so that commutative
+   *        operators agree irrespective of the operand order.
+   */
+  static Expression getCanonicalExpr(const BinaryOperator &BinaryOp) {
+    const Value *LHS = BinaryOp.getOperand(0), *RHS = BinaryOp.getOperand(1);
+    if (BinaryOp.isCommutative() && std::less<const Value *>()(RHS, LHS)) {
+      std::swap(LHS, RHS);
+    }
+    return Expression(BinaryOp.getOpcode(), LHS, RHS);
+  }
+
+  /**
+   * @brief Eliminate the redundant binary operators of @c BB and record the
+   *        expressions that it computes in @c S .
+   *
+   * @return the number of eliminated instructions
+   */
+  unsigned processBlock(BasicBlock &BB, Scope &S) {
+    unsigned NumEliminated = 0;
+    for (Instruction &Inst : make_early_inc_range(BB)) {
+      BinaryOperator *const BinaryOp = dyn_cast<BinaryOperator>(&Inst);
+      if (!BinaryOp) {
+        continue;
+      }
+      Expression Expr = getCanonicalExpr(*BinaryOp);
+      auto AvailIt = AvailExprs.find(Expr);
+      if (AvailIt == AvailExprs.end()) {
+        AvailExprs.emplace(Expr, BinaryOp);
+        S.Exprs.push_back(Expr);
+        continue;
+      }
+      // The surviving instruction may only keep the poison-generating flags
+      // (e.g., nsw) that both of the instructions carry.
+      AvailIt->second->andIRFlags(BinaryOp);
+      BinaryOp->replaceAllUsesWith(AvailIt->second);
+      BinaryOp->eraseFromParent();
+      ++NumEliminated;
+    }
+    return NumEliminated;
+  }
+
+public:
+  static char ID;
+
+  DomCSE() : FunctionPass(ID) {}
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  virtual bool runOnFunction(Function &F) override {
+    errs() << "* Dominator-Scoped CSE *"
+           << "\n";
+    DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+
+    // The walk is kept iterative so that deep dominator trees do not overflow
+    // the call stack.
+    unsigned NumEliminated = 0;
+    std::vector<Scope> Stack;
+    Stack.emplace_back(DT.getRootNode());
+    NumEliminated += processBlock(*DT.getRoot(), Stack.back());
+    while (!Stack.empty()) {
+      Scope &Top = Stack.back();
+      if (Top.NextChild != Top.Node->end()) {
+        const DomTreeNode *const Child = *Top.NextChild++;
+        Stack.emplace_back(Child);
+        NumEliminated += processBlock(*Child->getBlock(), Stack.back());
+        continue;
+      }
+      for (const Expression &Expr : Top.Exprs) {
+        AvailExprs.erase(Expr);
+      }
+      Stack.pop_back();
+    }
+    assert(AvailExprs.empty() && "All the scopes must have been closed");
+
+    errs() << "Eliminated " << NumEliminated << " expression(s) in "
+           << F.getName() << "\n";
+    NumDomCSE += NumEliminated;
+    return NumEliminated != 0;
+  }
+};
+
+char DomCSE::ID = 0;
+RegisterPass<DomCSE> X("dom-cse", "Dominator-Scoped CSE");
+
+} // anonymous namespace
@@ -1,5 +1,6 @@
 #pragma once // NOLINT(llvm-header-guard)
 
+#include <llvm/ADT/Hashing.h>
 #include <llvm/IR/Instruction.h>
 #include <llvm/IR/Instructions.h>
 #include <llvm/IR/Value.h>
@@ -16,6 +17,9 @@ struct Expression {
   Expression(const BinaryOperator &BinaryOp)
       : Opcode(BinaryOp.getOpcode()), LHS(BinaryOp.getOperand(0)),
         RHS(BinaryOp.getOperand(1)) {}
+  Expression(const unsigned Opcode, const Value *const LHS,
+             const Value *const RHS)
+      : Opcode(Opcode), LHS(LHS), RHS(RHS) {}
   /**
    * @todo(cscd70) Please complete the comparator.
    */
@@ -24,6 +28,17 @@ struct Expression {
   }
 };
 
+namespace std {
+
+template <> //
+struct hash<Expression> {
+  size_t operator()(const Expression &Expr) const {
+    return hash_combine(Expr.Opcode, Expr.LHS, Expr.RHS);
+  }
+};
+
+} // namespace std
+
 inline raw_ostream &operator<<(raw_ostream &Outs, const Expression &Expr) {
   Outs << "[" << Instruction::getOpcodeName(Expr.Opcode) << " ";
   Expr.LHS->printAsOperand(Outs, false);
@@ -29,8 +29,7 @@ private:
   	//TODO
   	if (const BinaryOperator *const BinaryOp =
   			dyn_cast<BinaryOperator>(&Inst)) {
-  		if (getPos(Expression(*BinaryOp)) == -1) {
-  			Domain.push_back(Expression(*BinaryOp));
+  		if (insertDomainElem(Expression(*BinaryOp))) {
   			errs() << Expression(*BinaryOp) << "\n";
   		}		
   	}
@@ -21,8 +21,7 @@ private:
   	//TODO
   	if (const BinaryOperator *const BinaryOp =
   			dyn_cast<BinaryOperator>(&Inst)) {
-  		if (getPos(Expression(*BinaryOp)) == -1)
-  			Domain.push_back(Expression(*BinaryOp));		
+  		insertDomainElem(Expression(*BinaryOp));
   	}
   }
   virtual bool transferFunc(const Instruction &Inst, const DomainVal_t &IBV,
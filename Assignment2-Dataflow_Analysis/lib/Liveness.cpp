@@ -31,9 +31,8 @@ private:
 	//TODO
 	for (const auto &op : Inst.operands()) {
 		if (isa<Instruction>(op) || isa<Argument>(op)) {
-			if (getPos(Variable(op)) == -1) {// avoid putting same variable into Domain more than once
-				Domain.push_back(Variable(op));
-			}
+			// avoid putting same variable into Domain more than once
+			insertDomainElem(Variable(op));
 		}
 	}
   }
@@ -15,6 +15,17 @@ struct Variable {
   bool operator==(const Variable &Var) const { return V == Var.V; }
 };
 
+namespace std {
+
+template <> //
+struct hash<Variable> {
+  size_t operator()(const Variable &Var) const {
+    return hash<const Value *>()(Var.V);
+  }
+};
+
+} // namespace std
+
 inline raw_ostream &operator<<(raw_ostream &Outs, const Variable &Var) {
   Var.V->printAsOperand(Outs, false);
   return Outs;
@@ -0,0 +1,79 @@
+; RUN: opt -S -load %dylibdir/libDFA.so \
+; RUN:     -avail-cse %s -o %basename_t 2>%basename_t.log
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t.log \
+; RUN:     --check-prefix=LOG
+
+; LOG-LABEL: * Available-Expression CSE *
+; LOG-NEXT:  Eliminated 2 expression(s) in diamond
+; LOG-LABEL: * Available-Expression CSE *
+; LOG-NEXT:  Eliminated 1 expression(s) in loop
+
+; int diamond(int a, int b, int c) {
+;   int d;
+;   if (c) {
+;     d = a + b;
+;   } else {
+;     d = (a + b) * 2;
+;   }
+;   return (a + b) * (a + b) + d;
+; }
+define i32 @diamond(i32 %0, i32 %1, i32 %2) {
+; CHECK-LABEL: define i32 @diamond(i32 %0, i32 %1, i32 %2) {
+  %4 = icmp ne i32 %2, 0
+  br i1 %4, label %5, label %7
+
+; CHECK:         %6 = add nsw i32 %0, %1
+5:                                                ; preds = %3
+  %6 = add nsw i32 %0, %1
+  br label %10
+
+; CHECK:         %8 = add i32 %0, %1
+; CHECK-NEXT:    %9 = mul nsw i32 %8, 2
+7:                                                ; preds = %3
+  %8 = add i32 %0, %1
+  %9 = mul nsw i32 %8, 2
+  br label %10
+
+; CHECK:         %11 = phi i32 [ %6, %5 ], [ %8, %7 ]
+; CHECK-NEXT:    %.0 = phi i32 [ %6, %5 ], [ %9, %7 ]
+; CHECK-NEXT:    %12 = mul nsw i32 %11, %11
+; CHECK-NEXT:    %13 = add nsw i32 %12, %.0
+; CHECK-NEXT:    ret i32 %13
+10:                                               ; preds = %7, %5
+  %.0 = phi i32 [ %6, %5 ], [ %9, %7 ]
+  %11 = add nsw i32 %0, %1
+  %12 = add nsw i32 %0, %1
+  %13 = mul nsw i32 %11, %12
+  %14 = add nsw i32 %13, %.0
+  ret i32 %14
+}
+
+; int loop(int a, int n) {
+;   int i = 0, t;
+;   do {
+;     t = i + a;
+;   } while (++i < n);
+;   return t + ((i - 1) + a);
+; }
+define i32 @loop(i32 %0, i32 %1) {
+; CHECK-LABEL: define i32 @loop(i32 %0, i32 %1) {
+  br label %3
+
+; The phi redefines %.0 on every iteration, which kills [add %.0, %0].
+; CHECK:         %.0 = phi i32 [ 0, %2 ], [ %5, %3 ]
+; CHECK-NEXT:    %4 = add nsw i32 %.0, %0
+3:                                                ; preds = %3, %2
+  %.0 = phi i32 [ 0, %2 ], [ %5, %3 ]
+  %4 = add nsw i32 %.0, %0
+  %5 = add nsw i32 %.0, 1
+  %6 = icmp slt i32 %5, %1
+  br i1 %6, label %3, label %7
+
+; CHECK:         %8 = add nsw i32 %4, %4
+; CHECK-NEXT:    ret i32 %8
+7:                                                ; preds = %3
+  %8 = add nsw i32 %.0, %0
+  %9 = add nsw i32 %4, %8
+  ret i32 %9
+}
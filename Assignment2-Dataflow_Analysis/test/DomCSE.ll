@@ -0,0 +1,61 @@
+; RUN: opt -S -load %dylibdir/libDFA.so \
+; RUN:     -dom-cse %s -o %basename_t 2>%basename_t.log
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t.log \
+; RUN:     --check-prefix=LOG
+
+; int foo(int a, int b) {
+;   int c = a + b, d;
+;   if (a > b) {
+;     d = b + a;
+;     c = c * (a - b);
+;   } else {
+;     d = a - b;
+;   }
+;   int e = a - b;
+;   return c + d + e + (a + b);
+; }
+; LOG-LABEL: * Dominator-Scoped CSE *
+; LOG-NEXT:  Eliminated 2 expression(s) in foo
+
+define i32 @foo(i32 %0, i32 %1) {
+; CHECK-LABEL: define i32 @foo(i32 %0, i32 %1) {
+; CHECK-NEXT:    %3 = add i32 %0, %1
+; CHECK-NEXT:    %4 = icmp sgt i32 %0, %1
+; CHECK-NEXT:    br i1 %4, label %5, label %8
+  %3 = add nsw i32 %0, %1
+  %4 = icmp sgt i32 %0, %1
+  br i1 %4, label %5, label %8
+
+; CHECK:         %6 = sub nsw i32 %0, %1
+; CHECK-NEXT:    %7 = mul nsw i32 %3, %6
+; CHECK-NEXT:    br label %10
+5:                                                ; preds = %2
+  %6 = sub nsw i32 %0, %1
+  %7 = mul nsw i32 %3, %6
+  %.0 = add i32 %1, %0
+  br label %10
+
+; CHECK:         %9 = sub nsw i32 %0, %1
+; CHECK-NEXT:    br label %10
+8:                                                ; preds = %2
+  %9 = sub nsw i32 %0, %1
+  br label %10
+
+; CHECK:         %.01 = phi i32 [ %3, %5 ], [ %9, %8 ]
+; CHECK-NEXT:    %.1 = phi i32 [ %7, %5 ], [ %3, %8 ]
+; CHECK-NEXT:    %11 = sub nsw i32 %0, %1
+; CHECK-NEXT:    %12 = add nsw i32 %.1, %.01
+; CHECK-NEXT:    %13 = add nsw i32 %12, %11
+; CHECK-NEXT:    %14 = add nsw i32 %13, %3
+; CHECK-NEXT:    ret i32 %14
+10:                                               ; preds = %8, %5
+  %.01 = phi i32 [ %.0, %5 ], [ %9, %8 ]
+  %.1 = phi i32 [ %7, %5 ], [ %3, %8 ]
+  %11 = sub nsw i32 %0, %1
+  %12 = add nsw i32 %.1, %.01
+  %13 = add nsw i32 %12, %11
+  %14 = add nsw i32 %0, %1
+  %15 = add nsw i32 %13, %14
+  ret i32 %15
+}
@@ -1,67 +1,882 @@
 /**
  * @file Loop Invariant Code Motion
  */
+#include <llvm/ADT/MapVector.h>
+#include <llvm/ADT/SetVector.h>
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Analysis/AliasAnalysis.h>
+#include <llvm/Analysis/BlockFrequencyInfo.h>
+#include <llvm/Analysis/LoopAccessAnalysis.h>
+#include <llvm/Analysis/LoopIterator.h>
 #include <llvm/Analysis/LoopPass.h>
+#include <llvm/Analysis/MemoryLocation.h>
+#include <llvm/Analysis/MustExecute.h>
+#include <llvm/Analysis/OptimizationRemarkEmitter.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ScopedNoAliasAA.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
 #include <llvm/Transforms/Utils.h>
+#include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/LoopUtils.h>
+#include <llvm/Transforms/Utils/LoopVersioning.h>
+#include <llvm/Transforms/Utils/SSAUpdater.h>
 #include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/Constants.h>
 #include <llvm/IR/Dominators.h>
 #include <llvm/IR/Instruction.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Debug.h>
+#include <memory>
+#include <unordered_map>
 #include <unordered_set>
+#include <vector>
+
+#include "RegPressure.h"
+
+#define DEBUG_TYPE "loop-invariant-code-motion"
 
 using namespace llvm;
 
+STATISTIC(NumInvariant, "Number of loop invariant instructions found");
+STATISTIC(NumHoisted, "Number of instructions hoisted");
+STATISTIC(NumHoistedFurther,
+          "Number of instructions hoisted past an enclosing loop");
+STATISTIC(NumNotProfitable,
+          "Number of invariants left in place as hoisting is not profitable");
+STATISTIC(NumHighPressure,
+          "Number of invariants left in place due to register pressure");
+STATISTIC(NumLoadsHoisted, "Number of loads hoisted");
+STATISTIC(NumPromoted, "Number of memory locations promoted to registers");
+STATISTIC(NumVersioned, "Number of loops versioned with runtime alias checks");
+STATISTIC(NumSunk, "Number of instructions sunk into the loop exits");
+STATISTIC(NumTrivialUnswitched,
+          "Number of loop exits unswitched without duplicating the loop");
+STATISTIC(NumUnswitched, "Number of branches unswitched by duplicating loops");
+
+static cl::opt<bool> RegPressureAware(
+    "licm-reg-pressure", cl::init(true), cl::Hidden,
+    cl::desc("Stop hoisting and promoting when the values live throughout a "
+             "loop would outnumber the registers of the target"));
+
+static cl::opt<bool> EnableVersioning(
+    "licm-versioning", cl::init(true), cl::Hidden,
+    cl::desc("Version loops whose memory accesses may alias with runtime "
+             "checks, so that LICM can hoist and promote in the fast version"));
+static cl::opt<unsigned> VersioningMaxChecks(
+    "licm-versioning-max-checks", cl::init(8), cl::Hidden,
+    cl::desc("Maximum number of runtime alias checks of a versioned loop"));
+static cl::opt<unsigned> VersioningMaxLoopSize(
+    "licm-versioning-max-loop-size", cl::init(128), cl::Hidden,
+    cl::desc("Maximum number of instructions of a loop to be versioned"));
+static cl::opt<unsigned> VersioningMaxLoops(
+    "licm-versioning-max-loops", cl::init(4), cl::Hidden,
+    cl::desc("Maximum number of loops to be versioned in each function"));
+
+static cl::opt<bool> EnableUnswitch(
+    "licm-unswitch", cl::init(true), cl::Hidden,
+    cl::desc("Unswitch the branches of loops on loop invariant conditions"));
+static cl::opt<unsigned> UnswitchMaxGrowth(
+    "licm-unswitch-max-growth", cl::init(256), cl::Hidden,
+    cl::desc("Maximum number of instructions that unswitching may duplicate "
+             "in each function"));
+
+// marks both versions of a loop, so that neither is versioned again
+static const char *const VersionedMD = "llvm.loop.licm_versioning.disable";
+
 namespace {
 
 class LoopInvariantCodeMotion final : public LoopPass {
 private:
-  //const LoopInfo const *loopInfo;
+  LoopInfo *loopInfo;
   DominatorTree *dominatorTree;
+  AAResults *AA;
+  BlockFrequencyInfo *BFI;
+  const TargetTransformInfo *TTI;
+  // whether the register pressure is taken into account for the loop
+  bool checkPressure;
+  ScalarEvolution *SE;
+  LoopAccessLegacyAnalysis *LAA;
+  OptimizationRemarkEmitter *ORE;
+
+  /**
+   * @brief Memory behavior of a loop, computed on demand.
+   */
+  struct LoopMemInfo {
+	// instructions of the loop that may write to memory
+	SmallVector<Instruction*, 16> writers;
+	SimpleLoopSafetyInfo safetyInfo;
+  };
+  std::unordered_map<const Loop*, std::unique_ptr<LoopMemInfo>> MemInfos;
+  LoopMemInfo &getMemInfo(const Loop *L) {
+	std::unique_ptr<LoopMemInfo> &memInfo = MemInfos[L];
+	if (!memInfo) {
+		memInfo = std::make_unique<LoopMemInfo>();
+		for (BasicBlock *B : L->getBlocks()) {
+			for (Instruction &I : *B) {
+				if (I.mayWriteToMemory())
+					memInfo->writers.push_back(&I);
+			}
+		}
+		memInfo->safetyInfo.computeLoopSafetyInfo(L);
+	}
+	return *memInfo;
+  }
+  std::unordered_map<const Loop*, std::unique_ptr<LoopRegPressure>> Pressures;
+  LoopRegPressure &getPressure(const Loop *L) {
+	std::unique_ptr<LoopRegPressure> &pressure = Pressures[L];
+	if (!pressure)
+		pressure = std::make_unique<LoopRegPressure>(*L, *TTI);
+	return *pressure;
+  }
+  /**
+   * @brief Check whether keeping @c I live throughout @c L , instead of its
+   *        operands, would still leave enough registers for the loop.
+   */
+  bool hasRegisterFor(const Loop *L, const Instruction *I) {
+	return !checkPressure || getPressure(L).hasRoomToHoist(*I);
+  }
+  /**
+   * @brief Check whether any instruction of @c L may modify @c loc .
+   */
+  bool isClobberedIn(const Loop *L, const MemoryLocation &loc) {
+	for (Instruction *writer : getMemInfo(L).writers) {
+		if (isModSet(AA->getModRefInfo(writer, loc)))
+			return true;
+	}
+	return false;
+  }
+
   std::unordered_set<Instruction*> InvarInstSet;
+  // loop invariant instructions in the order they are discovered, in which
+  // the operands of an instruction always come before the instruction itself
+  std::vector<Instruction*> InvarInsts;
   inline bool contains(Instruction *I) {
-	return std::find(InvarInstSet.begin(), InvarInstSet.end(), I) != InvarInstSet.end();
+	return InvarInstSet.count(I) != 0;
   }
   bool isInvariant(Loop *L, Instruction const *I) {
 	//TODO
-	bool isInvariant = true;
+	if (isa<PHINode>(I) || I->isTerminator() || isa<LandingPadInst>(I))
+		return false;
+	// A load is invariant if nothing in the loop may write to the location
+	// that it reads from. Whether it can be executed speculatively is checked
+	// upon hoisting.
+	if (auto load = dyn_cast<LoadInst>(I)) {
+		if (!load->isUnordered() || isClobberedIn(L, MemoryLocation::get(load)))
+			return false;
+	} else if (!isSafeToSpeculativelyExecute(I) || I->mayReadFromMemory()) {
+		return false;
+	}
 	for (auto &op : I->operands()) {
-		bool isDefOutsideLoop = false;
-		bool isInInvarInstSet = false;
-		bool isLiteral = isa<Constant>(op) || isa<Argument>(op);
 		if (auto opInst = dyn_cast<Instruction>(op)) {
-			isDefOutsideLoop = !L->contains(opInst);
-			isInInvarInstSet = contains(opInst);
+			if (L->contains(opInst) && !contains(opInst))
+				return false;
+		} else if (!isa<Constant>(op) && !isa<Argument>(op)) {
+			return false;
 		}
-		isInvariant = isInvariant && (isInInvarInstSet || isLiteral || isDefOutsideLoop);
 	}
-	return isSafeToSpeculativelyExecute(I)
-		&& !I->mayReadFromMemory()
-		&& !isa<LandingPadInst>(I)
-		&& isInvariant;
+	return true;
   }
-  bool traverseLoop(Loop *L) {
-	//TODO
-	bool change = false;
+  void markInvariant(Instruction *I, SmallVectorImpl<Instruction*> &worklist) {
+	InvarInstSet.insert(I);
+	InvarInsts.push_back(I);
+	worklist.push_back(I);
+  }
+  /**
+   * @brief Find the loop invariant instructions in linear time.
+   *
+   * A single scan seeds the worklist with the instructions whose operands are
+   * all defined outside the loop (or already known to be invariant). Since an
+   * instruction can only become invariant once one of its operands does, the
+   * worklist then only has to revisit the users of each new invariant.
+   */
+  void findInvariants(Loop *L) {
+	SmallVector<Instruction*, 32> worklist;
 	for (BasicBlock *B : L->getBlocks()) {
 		for (Instruction &I : *B) {
-			if (!contains(&I) && isInvariant(L, &I)) {
-				InvarInstSet.insert(&I);
-				change = true;
+			if (!contains(&I) && isInvariant(L, &I))
+				markInvariant(&I, worklist);
+		}
+	}
+	while (!worklist.empty()) {
+		Instruction *I = worklist.pop_back_val();
+		for (User *U : I->users()) {
+			auto userInst = dyn_cast<Instruction>(U);
+			if (userInst && L->contains(userInst) && !contains(userInst)
+				&& isInvariant(L, userInst))
+				markInvariant(userInst, worklist);
+		}
+	}
+  }
+  bool dominatesExits(Loop *L, Instruction *I) {
+	SmallVector<BasicBlock*> exitBlocks;
+	L->getExitBlocks(exitBlocks);
+	for (const auto &exitBlock : exitBlocks) {
+		if (!dominatorTree->dominates(I, exitBlock))
+			return false;
+	}
+	return true;
+  }
+  /**
+   * @brief Check whether @c I can be moved to the preheader of @c L , given
+   *        that its operands have already been hoisted as far as they can.
+   */
+  bool canHoistOutOf(Loop *L, Instruction *I) {
+	if (!L->getLoopPreheader() || !dominatesExits(L, I))
+		return false;
+	for (auto &op : I->operands()) {
+		auto opInst = dyn_cast<Instruction>(op);
+		if (opInst && L->contains(opInst))
+			return false;
+	}
+	if (auto load = dyn_cast<LoadInst>(I)) {
+		// Loading from an address that is not known to be dereferenceable is
+		// only fine if the loop would have executed the load anyway.
+		if (isClobberedIn(L, MemoryLocation::get(load)))
+			return false;
+		if (!isSafeToSpeculativelyExecute(load)
+			&& !getMemInfo(L).safetyInfo.isGuaranteedToExecute(*load, dominatorTree, L))
+			return false;
+	}
+	return true;
+  }
+  /**
+   * @brief Check whether @c I would run less often in the preheader of @c L
+   *        than in its current basic block.
+   *
+   * The frequencies come from the branch weights of the profile if there is
+   * one, and from static heuristics otherwise. Hoisting out of a loop that
+   * rarely iterates would merely add work to the paths entering it.
+   */
+  bool isProfitableToHoist(Loop *L, Instruction *I) {
+	return BFI->getBlockFreq(L->getLoopPreheader())
+	       < BFI->getBlockFreq(I->getParent());
+  }
+  /**
+   * @brief  Hoist @c I out of @c L and then out of as many enclosing loops as
+   *         legal and profitable, straight to the outermost preheader.
+   * @return the outermost loop that @c I has been hoisted out of, nullptr if
+   *         it has not been hoisted at all
+   */
+  Loop *tryHoist(Loop *L, Instruction *I) {
+	if (!canHoistOutOf(L, I))
+		return nullptr;
+	if (!isProfitableToHoist(L, I)) {
+		++NumNotProfitable;
+		ORE->emit([&]() {
+			return OptimizationRemarkMissed(DEBUG_TYPE, "NotProfitable", I)
+			       << "not hoisting " << ore::NV("Inst", I)
+			       << " as the preheader would not run it less often";
+		});
+		return nullptr;
+	}
+	if (!hasRegisterFor(L, I)) {
+		// A cheap instruction is better recomputed on every iteration than
+		// spilled and reloaded.
+		bool isCheap = TTI->getUserCost(I, TargetTransformInfo::TCK_SizeAndLatency)
+		               <= TargetTransformInfo::TCC_Basic;
+		++NumHighPressure;
+		ORE->emit([&]() {
+			return OptimizationRemarkMissed(DEBUG_TYPE, "RegisterPressure", I)
+			       << "not hoisting " << ore::NV("Inst", I) << ": "
+			       << (isCheap ? "it is cheap enough to be left in the loop, and "
+			                   : "")
+			       << "hoisting it would exceed the "
+			       << ore::NV("NumRegs", getPressure(L).getNumRegs(
+			                                 getPressure(L).getRegClass(*I)))
+			       << " registers of its class";
+		});
+		return nullptr;
+	}
+	Loop *targetLoop = L;
+	while (Loop *parentLoop = targetLoop->getParentLoop()) {
+		if (!canHoistOutOf(parentLoop, I) || !isProfitableToHoist(parentLoop, I)
+			|| !hasRegisterFor(parentLoop, I))
+			break;
+		targetLoop = parentLoop;
+	}
+	if (checkPressure) {
+		for (Loop *hoistedOutOf = L; hoistedOutOf != targetLoop->getParentLoop();
+		     hoistedOutOf = hoistedOutOf->getParentLoop())
+			getPressure(hoistedOutOf).hoisted(*I);
+	}
+	ORE->emit([&]() {
+		return OptimizationRemark(DEBUG_TYPE, "Hoisted", I)
+		       << "hoisting " << ore::NV("Inst", I) << " out of "
+		       << ore::NV("NumLoops", L->getLoopDepth() - targetLoop->getLoopDepth() + 1)
+		       << " loop(s)";
+	});
+	I->moveBefore(targetLoop->getLoopPreheader()->getTerminator());
+	return targetLoop;
+  }
+  /**
+   * @brief  Promote the memory locations that @c L accesses through a loop
+   *         invariant address to registers.
+   *
+   * The location is loaded once in the preheader, carried in SSA form through
+   * the loop and stored back at the exits. This is only legal if no other
+   * instruction of the loop may access the location, if one of the stores is
+   * guaranteed to execute (so that the stores at the exits and the load in
+   * the preheader do not introduce accesses the program would not make) and
+   * if the loop cannot be left by unwinding.
+   * @return the number of promoted locations
+   */
+  unsigned promoteMemoryToRegisters(Loop *L) {
+	LoopMemInfo &memInfo = getMemInfo(L);
+	if (memInfo.safetyInfo.anyBlockMayThrow())
+		return 0;
+
+	// group the unordered loads and stores by their loop invariant address
+	MapVector<Value*, SmallVector<Instruction*, 8>> accessesByPtr;
+	SmallVector<Instruction*, 32> memInsts;
+	for (BasicBlock *B : L->getBlocks()) {
+		for (Instruction &I : *B) {
+			if (!I.mayReadOrWriteMemory())
+				continue;
+			memInsts.push_back(&I);
+			Value *ptr = getLoadStorePointerOperand(&I);
+			if (!ptr || (isa<LoadInst>(I) && !cast<LoadInst>(I).isUnordered())
+				|| (isa<StoreInst>(I) && !cast<StoreInst>(I).isUnordered()))
+				continue;
+			auto ptrInst = dyn_cast<Instruction>(ptr);
+			if (ptrInst && L->contains(ptrInst))
+				continue;
+			accessesByPtr[ptr].push_back(&I);
+		}
+	}
+
+	unsigned numPromoted = 0;
+	for (auto &ptrAccessesPair : accessesByPtr) {
+		// the promoted value is carried across the iterations in a register
+		Instruction *access = ptrAccessesPair.second.front();
+		Value *accessedVal = isa<StoreInst>(access)
+		                     ? cast<StoreInst>(access)->getValueOperand() : access;
+		if (checkPressure && !getPressure(L).hasRoomFor(*accessedVal))
+			continue;
+		if (!promote(L, ptrAccessesPair.first, ptrAccessesPair.second, memInsts))
+			continue;
+		++numPromoted;
+		if (checkPressure)
+			getPressure(L).addLiveThrough(*accessedVal);
+		// the promoted accesses have been erased
+		std::unordered_set<Instruction*> erased(ptrAccessesPair.second.begin(),
+		                                        ptrAccessesPair.second.end());
+		erase_if(memInsts, [&](Instruction *I) { return erased.count(I); });
+	}
+	return numPromoted;
+  }
+  bool promote(Loop *L, Value *ptr, const SmallVectorImpl<Instruction*> &accesses,
+               const SmallVectorImpl<Instruction*> &memInsts) {
+	LoopMemInfo &memInfo = getMemInfo(L);
+	Type *ty = getLoadStoreType(accesses.front());
+	Align alignment = getLoadStoreAlignment(accesses.front());
+	bool hasGuaranteedStore = false;
+	for (Instruction *access : accesses) {
+		if (getLoadStoreType(access) != ty)
+			return false;
+		alignment = std::min(alignment, getLoadStoreAlignment(access));
+		if (isa<StoreInst>(access)
+			&& memInfo.safetyInfo.isGuaranteedToExecute(*access, dominatorTree, L))
+			hasGuaranteedStore = true;
+	}
+	if (!hasGuaranteedStore)
+		return false;
+	std::unordered_set<const Instruction*> accessSet(accesses.begin(), accesses.end());
+	MemoryLocation loc = MemoryLocation::get(accesses.front());
+	for (Instruction *memInst : memInsts) {
+		if (!accessSet.count(memInst)
+			&& isModOrRefSet(AA->getModRefInfo(memInst, loc)))
+			return false;
+	}
+
+	BasicBlock *preheader = L->getLoopPreheader();
+	std::string name = (ptr->getName() + ".promoted").str();
+	SSAUpdater SSA;
+	SSA.Initialize(ty, name);
+	LoadInst *preheaderLoad = new LoadInst(ty, ptr, name, false, alignment,
+	                                       preheader->getTerminator());
+	SSA.AddAvailableValue(preheader, preheaderLoad);
+	// the value at the end of a basic block is that of its last store
+	for (Instruction *access : accesses) {
+		if (auto store = dyn_cast<StoreInst>(access))
+			SSA.AddAvailableValue(store->getParent(), store->getValueOperand());
+	}
+	// Each load yields the value of the last store before it in the same
+	// basic block, or else the value live into the block.
+	std::unordered_map<Value*, Value*> repls;
+	for (BasicBlock *B : L->getBlocks()) {
+		Value *curVal = nullptr;
+		for (Instruction &I : *B) {
+			if (!accessSet.count(&I))
+				continue;
+			if (auto store = dyn_cast<StoreInst>(&I))
+				curVal = store->getValueOperand();
+			else
+				repls[&I] = curVal ? curVal : SSA.GetValueInMiddleOfBlock(B);
+		}
+	}
+	SmallVector<BasicBlock*, 8> exitBlocks;
+	L->getUniqueExitBlocks(exitBlocks);
+	for (BasicBlock *exitBlock : exitBlocks) {
+		new StoreInst(SSA.GetValueInMiddleOfBlock(exitBlock), ptr, false,
+		              alignment, &*exitBlock->getFirstInsertionPt());
+	}
+
+	// A load may be replaced by the value of another promoted load.
+	for (auto &replPair : repls) {
+		Value *repl = replPair.second;
+		for (auto replIt = repls.find(repl); replIt != repls.end();
+			 replIt = repls.find(repl))
+			repl = replIt->second;
+		replPair.first->replaceAllUsesWith(repl);
+	}
+	for (Instruction *access : accesses)
+		access->eraseFromParent();
+	return true;
+  }
+  /**
+   * @brief  Sink @c I into the exit blocks of @c L that its results are used
+   *         in, with a copy for each of them.
+   *
+   * Every exit that receives a copy must be dominated by @c I , so that the
+   * copy recomputes the value of the last iteration, from operands that have
+   * not been redefined since, and does not execute on paths that @c I did
+   * not execute on. Phis in an exit whose incoming values are all @c I (e.g.,
+   * the ones of the LCSSA form) are replaced with the copy.
+   * @return whether @c I has been sunk
+   */
+  bool trySink(Loop *L, Instruction *I) {
+	if (isa<PHINode>(I) || I->isTerminator() || I->isEHPad() || isa<CallBase>(I)
+		|| I->mayHaveSideEffects() || I->mayReadFromMemory()
+		|| loopInfo->getLoopFor(I->getParent()) != L)
+		return false;
+	SmallVector<BasicBlock*, 8> exitBlocks;
+	L->getUniqueExitBlocks(exitBlocks);
+	MapVector<BasicBlock*, SmallSetVector<Instruction*, 4>> usersByExit;
+	for (User *U : I->users()) {
+		auto userInst = cast<Instruction>(U);
+		if (L->contains(userInst))
+			return false;
+		BasicBlock *userExit = nullptr;
+		for (BasicBlock *exitBlock : exitBlocks) {
+			if (exitBlock->getFirstInsertionPt() == exitBlock->end()
+				|| !dominatorTree->dominates(I, exitBlock))
+				continue;
+			if (auto phi = dyn_cast<PHINode>(userInst)) {
+				if (phi->getParent() == exitBlock
+					&& all_of(phi->incoming_values(),
+					          [I](Value *V) { return V == I; }))
+					userExit = exitBlock;
+			} else if (dominatorTree->dominates(exitBlock, userInst->getParent())) {
+				userExit = exitBlock;
+			}
+			if (userExit)
+				break;
+		}
+		if (!userExit)
+			return false;
+		usersByExit[userExit].insert(userInst);
+	}
+	if (usersByExit.empty())
+		return false;
+
+	// the last exit gets the instruction itself, the others a copy
+	unsigned numExitsLeft = usersByExit.size();
+	for (auto &exitUsersPair : usersByExit) {
+		Instruction *insertPt = &*exitUsersPair.first->getFirstInsertionPt();
+		Instruction *copy = I;
+		if (--numExitsLeft != 0) {
+			copy = I->clone();
+			copy->setName(I->getName());
+			copy->insertBefore(insertPt);
+		} else {
+			I->moveBefore(insertPt);
+		}
+		for (Instruction *user : exitUsersPair.second) {
+			if (auto phi = dyn_cast<PHINode>(user)) {
+				phi->replaceAllUsesWith(copy);
+				phi->eraseFromParent();
+			} else {
+				user->replaceUsesOfWith(I, copy);
+			}
+		}
+	}
+	return true;
+  }
+  // number of loops versioned so far in each function
+  std::unordered_map<const Function*, unsigned> NumVersionedLoops;
+  /**
+   * @brief Check whether @c L accesses memory through a loop invariant
+   *        address that may, though need not, alias another access of the
+   *        loop, one of the two being a write.
+   *
+   * Those are the accesses that runtime checks can free for LICM, whereas the
+   * ones that surely alias would make the checks fail every time.
+   */
+  bool hasAmbiguousInvariantAccess(Loop *L) {
+	SmallVector<Instruction*, 32> memInsts;
+	for (BasicBlock *B : L->getBlocks()) {
+		for (Instruction &I : *B) {
+			if (!I.mayReadOrWriteMemory())
+				continue;
+			if (!getLoadStorePointerOperand(&I))
+				return false;
+			memInsts.push_back(&I);
+		}
+	}
+	for (Instruction *access : memInsts) {
+		Value *ptr = getLoadStorePointerOperand(access);
+		auto ptrInst = dyn_cast<Instruction>(ptr);
+		if (ptrInst && L->contains(ptrInst))
+			continue;
+		for (Instruction *other : memInsts) {
+			if (getLoadStorePointerOperand(other) == ptr
+				|| (!access->mayWriteToMemory() && !other->mayWriteToMemory()))
+				continue;
+			AliasResult aliasResult = AA->alias(MemoryLocation::get(access),
+			                                    MemoryLocation::get(other));
+			if (aliasResult != AliasResult::NoAlias
+				&& aliasResult != AliasResult::MustAlias)
+				return true;
+		}
+	}
+	return false;
+  }
+  /**
+   * @brief  Version @c L with runtime checks that the memory it accesses
+   *         through different pointers does not overlap.
+   *
+   * @c L itself becomes the fast version, whose accesses are marked as not
+   * aliasing each other so that they can be hoisted and promoted, while a
+   * clone of it, left as it was, runs whenever a check fails. Since the clone
+   * doubles the loop, only small loops are versioned, and only a few of them
+   * per function.
+   * @return whether @c L has been versioned
+   */
+  bool tryVersion(Loop *L, LPPassManager &LPM) {
+	if (!EnableVersioning || !L->isInnermost() || !L->getExitBlock()
+		|| getBooleanLoopAttribute(L, VersionedMD)
+		|| !hasAmbiguousInvariantAccess(L))
+		return false;
+	Function *F = L->getHeader()->getParent();
+	unsigned loopSize = 0;
+	for (BasicBlock *B : L->getBlocks())
+		loopSize += B->size();
+	if (loopSize > VersioningMaxLoopSize
+		|| NumVersionedLoops[F] >= VersioningMaxLoops) {
+		ORE->emit([&]() {
+			return OptimizationRemarkMissed(DEBUG_TYPE, "VersioningBudget",
+			                                L->getStartLoc(), L->getHeader())
+			       << "not versioning a loop of " << ore::NV("LoopSize", loopSize)
+			       << " instructions as it exceeds the code size budget";
+		});
+		return false;
+	}
+	// The checks are only generated if they cover all the pairs of pointers
+	// that may alias. The accesses through the same pointer group, however
+	// dependent, stay ordered in the fast version.
+	const LoopAccessInfo &LAI = LAA->getInfo(L);
+	const RuntimePointerChecking *checking = LAI.getRuntimePointerChecking();
+	if (checking->getChecks().empty()
+		|| checking->getNumberOfChecks() > VersioningMaxChecks)
+		return false;
+
+	formLCSSA(*L, *dominatorTree, loopInfo, SE);
+	uint64_t checkFreq = BFI->getBlockFreq(L->getLoopPreheader()).getFrequency();
+	LoopVersioning versioning(LAI, checking->getChecks(), L, loopInfo,
+	                          dominatorTree, SE);
+	versioning.versionLoop();
+	// As for unswitching, both versions keep the frequencies of the loop.
+	Loop *fallback = versioning.getNonVersionedLoop();
+	BFI->setBlockFreq(L->getLoopPreheader(), checkFreq);
+	BFI->setBlockFreq(fallback->getLoopPreheader(), checkFreq);
+	for (auto blockPair : zip(L->getBlocks(), fallback->getBlocks())) {
+		BFI->setBlockFreq(std::get<1>(blockPair),
+		                  BFI->getBlockFreq(std::get<0>(blockPair)).getFrequency());
+	}
+	versioning.annotateLoopWithNoAlias();
+	addStringMetadataToLoop(versioning.getVersionedLoop(), VersionedMD, 1);
+	addStringMetadataToLoop(fallback, VersionedMD, 1);
+	LPM.addLoop(*fallback);
+	++NumVersionedLoops[F];
+	ORE->emit([&]() {
+		return OptimizationRemark(DEBUG_TYPE, "Versioned", L->getStartLoc(),
+		                          L->getHeader())
+		       << "versioned loop with "
+		       << ore::NV("NumChecks", checking->getNumberOfChecks())
+		       << " runtime alias check(s)";
+	});
+	return true;
+  }
+  // number of instructions duplicated by unswitching in each function
+  std::unordered_map<const Function*, unsigned> UnswitchGrowth;
+  /**
+   * @brief  Get the condition of @c BI if it is loop invariant and can be
+   *         evaluated in the preheader of @c L .
+   *
+   * The condition may still be computed inside the loop, as long as it is one
+   * of the invariants whose operands have all been hoisted.
+   */
+  Value *getInvariantCondition(Loop *L, BranchInst *BI) {
+	if (!BI || !BI->isConditional() || BI->getSuccessor(0) == BI->getSuccessor(1))
+		return nullptr;
+	Value *cond = BI->getCondition();
+	if (isa<Constant>(cond))
+		return nullptr;
+	auto condInst = dyn_cast<Instruction>(cond);
+	if (!condInst || !L->contains(condInst))
+		return cond;
+	if (!contains(condInst) || isa<LoadInst>(condInst))
+		return nullptr;
+	for (auto &op : condInst->operands()) {
+		auto opInst = dyn_cast<Instruction>(op);
+		if (opInst && L->contains(opInst))
+			return nullptr;
+	}
+	return cond;
+  }
+  void makeAvailableInPreheader(Loop *L, Value *cond) {
+	auto condInst = dyn_cast<Instruction>(cond);
+	if (condInst && L->contains(condInst))
+		condInst->moveBefore(L->getLoopPreheader()->getTerminator());
+  }
+  /**
+   * @brief Replace the uses of @c V inside @c L with @c C .
+   */
+  static void replaceUsesInLoop(Value *V, Loop *L, Constant *C) {
+	for (Use &U : make_early_inc_range(V->uses())) {
+		auto userInst = dyn_cast<Instruction>(U.getUser());
+		if (userInst && L->contains(userInst))
+			U.set(C);
+	}
+  }
+  /**
+   * @brief Find a branch that decides, at the start of each iteration of
+   *        @c L and on a loop invariant condition, whether to leave the loop.
+   *
+   * Such a branch can be moved to the preheader as it is, since leaving the
+   * loop through it can only happen in the first iteration: the header and
+   * the blocks that unconditionally follow it until the branch must thus be
+   * free of side effects, and the values that the exit uses must be known
+   * before the loop.
+   */
+  BranchInst *findTrivialUnswitchCandidate(Loop *L) {
+	SmallPtrSet<BasicBlock*, 8> visited;
+	BasicBlock *curBlock = L->getHeader();
+	while (visited.insert(curBlock).second) {
+		for (Instruction &I : *curBlock) {
+			if (I.mayHaveSideEffects() && !I.isTerminator())
+				return nullptr;
+		}
+		auto BI = dyn_cast<BranchInst>(curBlock->getTerminator());
+		if (!BI)
+			return nullptr;
+		if (BI->isUnconditional()) {
+			curBlock = BI->getSuccessor(0);
+			if (!L->contains(curBlock))
+				return nullptr;
+			continue;
+		}
+		if (!getInvariantCondition(L, BI)
+			|| L->contains(BI->getSuccessor(0)) == L->contains(BI->getSuccessor(1)))
+			return nullptr;
+		BasicBlock *exitBlock = BI->getSuccessor(L->contains(BI->getSuccessor(0)));
+		if (exitBlock->getSinglePredecessor() != curBlock)
+			return nullptr;
+		for (PHINode &phi : exitBlock->phis()) {
+			auto incomingInst = dyn_cast<Instruction>(phi.getIncomingValue(0));
+			if (incomingInst && L->contains(incomingInst)
+				&& !(isa<PHINode>(incomingInst)
+				     && incomingInst->getParent() == L->getHeader()))
+				return nullptr;
+		}
+		// no value of the loop may reach the exit other than through its phis
+		for (BasicBlock *B : L->getBlocks()) {
+			for (Instruction &I : *B) {
+				for (Use &U : I.uses()) {
+					auto userInst = cast<Instruction>(U.getUser());
+					BasicBlock *useBlock = userInst->getParent();
+					if (auto phi = dyn_cast<PHINode>(userInst)) {
+						if (useBlock == exitBlock)
+							continue;
+						useBlock = phi->getIncomingBlock(U);
+					}
+					if (!L->contains(useBlock)
+						&& dominatorTree->dominates(exitBlock, useBlock))
+						return nullptr;
+				}
 			}
-		} 
+		}
+		return BI;
+	}
+	return nullptr;
+  }
+  /**
+   * @brief Move the exiting branch @c BI of @c L to a new block right before
+   *        its preheader, which then only enters the loop if it would not
+   *        have been left right away.
+   */
+  void unswitchTrivially(Loop *L, BranchInst *BI) {
+	Value *cond = getInvariantCondition(L, BI);
+	makeAvailableInPreheader(L, cond);
+	unsigned exitIdx = L->contains(BI->getSuccessor(0));
+	BasicBlock *exitBlock = BI->getSuccessor(exitIdx),
+	           *loopSucc = BI->getSuccessor(1 - exitIdx);
+	BasicBlock *checkBlock = L->getLoopPreheader();
+	BasicBlock *preheader = SplitBlock(checkBlock, checkBlock->getTerminator(),
+	                                   dominatorTree, loopInfo);
+	BFI->setBlockFreq(preheader, BFI->getBlockFreq(checkBlock).getFrequency());
+
+	// the exit now takes the values of the first iteration
+	for (PHINode &phi : exitBlock->phis()) {
+		Value *val = phi.getIncomingValue(0);
+		auto headerPhi = dyn_cast<PHINode>(val);
+		if (headerPhi && headerPhi->getParent() == L->getHeader())
+			val = headerPhi->getIncomingValueForBlock(preheader);
+		phi.setIncomingValue(0, val);
+		phi.setIncomingBlock(0, checkBlock);
 	}
-	return change;
+	Instruction *checkTerm = checkBlock->getTerminator();
+	BranchInst::Create(exitIdx == 0 ? exitBlock : preheader,
+	                   exitIdx == 0 ? preheader : exitBlock, cond, checkTerm);
+	checkTerm->eraseFromParent();
+	BasicBlock *exitingBlock = BI->getParent();
+	BranchInst::Create(loopSucc, BI);
+	BI->eraseFromParent();
+	// Not only the exit moves up in the tree, but also e.g. a block where it
+	// meets another exit of the loop.
+	dominatorTree->applyUpdates({{DominatorTree::Insert, checkBlock, exitBlock},
+	                             {DominatorTree::Delete, exitingBlock, exitBlock}});
+	// inside the loop, the condition is known to lead into the loop
+	replaceUsesInLoop(cond, L, ConstantInt::getBool(cond->getContext(),
+	                                                exitIdx == 1));
+	SE->forgetLoop(L);
   }
-  void tryHoist(Loop *L, Instruction *I) {
-	SmallVector<BasicBlock*> uniqueExitBlocks;
-	L->getExitBlocks(uniqueExitBlocks);
-	//errs() << "\t" << *I << "\n";
-	for (const auto &exitBlock : uniqueExitBlocks) {
-		if(dominatorTree->dominates(I, exitBlock)) {
-			//errs() << "\texitBlock " << *exitBlock << "\n"; 
-			I->moveBefore((L->getLoopPreheader())->getTerminator());
+  /**
+   * @brief  Duplicate @c L into a version for each outcome of @c BI and
+   *         choose between them before the loop.
+   *
+   * The branch of either version then has a constant condition, left for the
+   * CFG simplification to fold. Both versions must share a single exit block,
+   * with the values of the loop flowing to it through LCSSA phis.
+   * @return whether @c L has been unswitched
+   */
+  bool unswitch(Loop *L, BranchInst *BI, LPPassManager &LPM) {
+	Function *F = L->getHeader()->getParent();
+	unsigned loopSize = 0;
+	for (BasicBlock *B : L->getBlocks())
+		loopSize += B->size();
+	if (UnswitchGrowth[F] + loopSize > UnswitchMaxGrowth) {
+		ORE->emit([&]() {
+			return OptimizationRemarkMissed(DEBUG_TYPE, "UnswitchBudget", BI)
+			       << "not unswitching a loop of " << ore::NV("LoopSize", loopSize)
+			       << " instructions as it exceeds the code growth budget";
+		});
+		return false;
+	}
+	UnswitchGrowth[F] += loopSize;
+
+	Value *cond = getInvariantCondition(L, BI);
+	makeAvailableInPreheader(L, cond);
+	formLCSSA(*L, *dominatorTree, loopInfo, SE);
+	BasicBlock *checkBlock = L->getLoopPreheader();
+	// Branching on poison is undefined behavior, which the loop may not have
+	// had if it did not reach the branch.
+	SimpleLoopSafetyInfo safetyInfo;
+	safetyInfo.computeLoopSafetyInfo(L);
+	if (!safetyInfo.isGuaranteedToExecute(*BI, dominatorTree, L)
+		&& !isGuaranteedNotToBeUndefOrPoison(cond, nullptr,
+		                                     checkBlock->getTerminator(),
+		                                     dominatorTree))
+		cond = new FreezeInst(cond, cond->getName() + ".fr",
+		                      checkBlock->getTerminator());
+	BasicBlock *preheader = SplitBlock(checkBlock, checkBlock->getTerminator(),
+	                                   dominatorTree, loopInfo);
+	BFI->setBlockFreq(preheader, BFI->getBlockFreq(checkBlock).getFrequency());
+	BasicBlock *exitBlock = L->getExitBlock();
+
+	ValueToValueMapTy VMap;
+	SmallVector<BasicBlock*, 16> clonedBlocks;
+	Loop *clonedLoop = cloneLoopWithPreheader(preheader, checkBlock, L, VMap,
+	                                          ".us", loopInfo, dominatorTree,
+	                                          clonedBlocks);
+	remapInstructionsInBlocks(clonedBlocks, VMap);
+	BFI->setBlockFreq(cast<BasicBlock>(VMap[preheader]),
+	                  BFI->getBlockFreq(preheader).getFrequency());
+	for (BasicBlock *B : L->getBlocks()) {
+		BFI->setBlockFreq(cast<BasicBlock>(VMap[B]),
+		                  BFI->getBlockFreq(B).getFrequency());
+	}
+
+	Instruction *checkTerm = checkBlock->getTerminator();
+	BranchInst::Create(preheader, clonedLoop->getLoopPreheader(), cond, checkTerm);
+	checkTerm->eraseFromParent();
+	// the exit is reached from the exiting blocks of both versions
+	for (PHINode &phi : exitBlock->phis()) {
+		for (unsigned i = 0, e = phi.getNumIncomingValues(); i != e; ++i) {
+			Value *val = phi.getIncomingValue(i);
+			if (Value *clonedVal = VMap.lookup(val))
+				val = clonedVal;
+			phi.addIncoming(val, cast<BasicBlock>(VMap[phi.getIncomingBlock(i)]));
+		}
+	}
+	dominatorTree->changeImmediateDominator(exitBlock, checkBlock);
+	formDedicatedExitBlocks(L, dominatorTree, loopInfo, nullptr, true);
+	formDedicatedExitBlocks(clonedLoop, dominatorTree, loopInfo, nullptr, true);
+
+	Value *loopCond = BI->getCondition();
+	replaceUsesInLoop(loopCond, L, ConstantInt::getTrue(loopCond->getContext()));
+	replaceUsesInLoop(loopCond, clonedLoop,
+	                  ConstantInt::getFalse(loopCond->getContext()));
+	LPM.addLoop(*clonedLoop);
+	SE->forgetLoop(L);
+	ORE->emit([&]() {
+		return OptimizationRemark(DEBUG_TYPE, "Unswitched", L->getStartLoc(),
+		                          L->getHeader())
+		       << "unswitched the loop, duplicating "
+		       << ore::NV("LoopSize", loopSize) << " instructions";
+	});
+	return true;
+  }
+  /**
+   * @brief  Unswitch the branches of @c L on loop invariant conditions, the
+   *         trivial ones first.
+   * @return the number of unswitched branches
+   */
+  unsigned unswitchInvariantBranches(Loop *L, LPPassManager &LPM) {
+	if (!EnableUnswitch)
+		return 0;
+	unsigned numUnswitched = 0;
+	while (BranchInst *BI = findTrivialUnswitchCandidate(L)) {
+		unswitchTrivially(L, BI);
+		ORE->emit([&]() {
+			return OptimizationRemark(DEBUG_TYPE, "UnswitchedTrivially",
+			                          L->getStartLoc(), L->getHeader())
+			       << "unswitched an exit of the loop";
+		});
+		++NumTrivialUnswitched;
+		++numUnswitched;
+	}
+	// Duplicating loops with subloops would leave the subloops of the copy
+	// out of the loop pass manager.
+	while (L->isInnermost() && L->getExitBlock()) {
+		BranchInst *candidate = nullptr;
+		for (BasicBlock *B : L->getBlocks()) {
+			auto BI = dyn_cast<BranchInst>(B->getTerminator());
+			if (getInvariantCondition(L, BI)) {
+				candidate = BI;
+				break;
+			}
 		}
+		if (!candidate)
+			break;
+		if (!unswitch(L, candidate, LPM))
+			break;
+		++NumUnswitched;
+		++numUnswitched;
 	}
+	return numUnswitched;
   }
 public:
   static char ID;
@@ -74,36 +889,111 @@ public:
      */
 	AU.addRequiredID(LoopSimplifyID);
 	AU.addRequired<DominatorTreeWrapperPass>();
-	//AU.addRequired<LoopInfoWrapperPass>();
-    AU.setPreservesCFG();
+	AU.addRequired<AAResultsWrapperPass>();
+	AU.addRequired<LoopInfoWrapperPass>();
+	AU.addRequired<BlockFrequencyInfoWrapperPass>();
+	AU.addRequired<TargetTransformInfoWrapperPass>();
+	AU.addRequired<ScalarEvolutionWrapperPass>();
+	AU.addRequired<LoopAccessLegacyAnalysis>();
+	AU.addRequired<ScopedNoAliasAAWrapperPass>();
+	// versioning changes the CFG but keeps these up to date
+	AU.addPreserved<DominatorTreeWrapperPass>();
+	AU.addPreserved<LoopInfoWrapperPass>();
+	AU.addPreserved<AAResultsWrapperPass>();
   }
 
   /**
    * @todo(cscd70) Please finish the implementation of this method.
    */
   virtual bool runOnLoop(Loop *L, LPPassManager &LPM) override { 
-	//if (!loopInfo)	loopInfo = &(getAnalysis<LoopInfoWrapperPass>().getLoopInfo());
-	errs() << dominatorTree << "\n";
 	if (!L->getLoopPreheader()) {
 		errs() << "Loop not in simplified form!\n";
 		return false;
 	}
 
 	dominatorTree = &(getAnalysis<DominatorTreeWrapperPass>().getDomTree());
+	AA = &(getAnalysis<AAResultsWrapperPass>().getAAResults());
+	loopInfo = &(getAnalysis<LoopInfoWrapperPass>().getLoopInfo());
+	BFI = &(getAnalysis<BlockFrequencyInfoWrapperPass>().getBFI());
+	TTI = &(getAnalysis<TargetTransformInfoWrapperPass>().getTTI(
+	    *L->getHeader()->getParent()));
+	// Without a target, the register count of TTI is a mere placeholder.
+	checkPressure = RegPressureAware
+	                && !L->getHeader()->getModule()->getTargetTriple().empty();
+	// The remark emitter cannot be required as an analysis, because a loop
+	// pass would have to preserve it.
+	OptimizationRemarkEmitter loopORE(L->getHeader()->getParent(), BFI);
+	ORE = &loopORE;
+	SE = &(getAnalysis<ScalarEvolutionWrapperPass>().getSE());
+	LAA = &getAnalysis<LoopAccessLegacyAnalysis>();
 	// Wrong!
 	//if (!dominatorTree)	dominatorTree = &(getAnalysis<DominatorTreeWrapperPass>().getDomTree());
 
-	// find loop invariant instructions
-	while (traverseLoop(L)) {
+	// The loop pass manager visits the loops of a nest innermost first, so
+	// the state of each loop starts afresh.
+	InvarInstSet.clear();
+	InvarInsts.clear();
+	MemInfos.clear();
+	Pressures.clear();
 
-	}
+	// split off a fast version of the loop where the pointers do not alias
+	bool versioned = tryVersion(L, LPM);
+
+	// find loop invariant instructions
+	findInvariants(L);
 	
-	// hoist or sink loop invariant instructions
-	for (auto &invarInst : InvarInstSet) {
+	// hoist or sink loop invariant instructions, operands first
+	unsigned numHoisted = 0, numHoistedFurther = 0, numLoadsHoisted = 0;
+	for (auto &invarInst : InvarInsts) {
 		//errs() << "\t" << *invarInst << "\n";
-		tryHoist(L, invarInst);
+		Loop *targetLoop = tryHoist(L, invarInst);
+		if (!targetLoop)
+			continue;
+		++numHoisted;
+		if (targetLoop != L)
+			++numHoistedFurther;
+		if (isa<LoadInst>(invarInst))
+			++numLoadsHoisted;
 	}
-	return false;
+
+	// keep the loop carried memory locations in registers
+	unsigned numPromoted = promoteMemoryToRegisters(L);
+
+	// sink what is only used after the loop, visiting the users of an
+	// instruction before the instruction itself so that chains sink as a whole
+	unsigned numSunk = 0;
+	LoopBlocksDFS loopBlocksDFS(L);
+	loopBlocksDFS.perform(loopInfo);
+	for (BasicBlock *B : make_range(loopBlocksDFS.beginPostorder(),
+	                                loopBlocksDFS.endPostorder())) {
+		for (Instruction &I : make_early_inc_range(reverse(*B))) {
+			if (trySink(L, &I))
+				++numSunk;
+		}
+	}
+
+	// take the branches on invariant conditions out of the loop
+	unsigned numUnswitched = unswitchInvariantBranches(L, LPM);
+	LLVM_DEBUG(dbgs() << "LICM: loop " << L->getHeader()->getName()
+	                  << " (depth " << L->getLoopDepth() << "): "
+	                  << InvarInsts.size() << " invariant, " << numHoisted
+	                  << " hoisted, " << numHoistedFurther
+	                  << " of them past an enclosing loop, " << numLoadsHoisted
+	                  << " loads hoisted, " << numPromoted
+	                  << " locations promoted, " << numSunk << " sunk"
+	                  << ", " << numUnswitched << " branches unswitched"
+	                  << (versioned ? " (versioned)" : "") << "\n");
+	NumInvariant += InvarInsts.size();
+	NumHoisted += numHoisted;
+	NumHoistedFurther += numHoistedFurther;
+	NumLoadsHoisted += numLoadsHoisted;
+	NumPromoted += numPromoted;
+	NumSunk += numSunk;
+	NumVersioned += versioned;
+	MemInfos.clear();
+	Pressures.clear();
+	return versioned || numHoisted != 0 || numPromoted != 0 || numSunk != 0
+	       || numUnswitched != 0;
   }
 };
 
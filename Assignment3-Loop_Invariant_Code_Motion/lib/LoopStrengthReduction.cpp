@@ -0,0 +1,247 @@
+/**
+ * @file Loop Induction Variable Strength Reduction
+ */
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Analysis/LoopPass.h>
+#include <llvm/Analysis/OptimizationRemarkEmitter.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/ScalarEvolutionExpressions.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/ValueHandle.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Debug.h>
+#include <llvm/Transforms/Utils.h>
+#include <llvm/Transforms/Utils/Local.h>
+#include <llvm/Transforms/Utils/ScalarEvolutionExpander.h>
+
+#include <memory>
+
+#include "RegPressure.h"
+
+#define DEBUG_TYPE "loop-strength-reduction"
+
+STATISTIC(NumReduced, "Number of instructions strength reduced");
+STATISTIC(NumPhisInserted, "Number of induction variable phis inserted");
+STATISTIC(NumHighPressure,
+          "Number of candidates left in place due to register pressure");
+
+static cl::opt<unsigned> ExpansionBudget(
+    "lsr-expansion-budget", cl::init(4), cl::Hidden,
+    cl::desc("Maximum cost of computing the initial value and the step of an "
+             "induction variable in the preheader"));
+
+namespace {
+
+/**
+ * @brief Strength reduction of the affine induction variables of a loop.
+ *
+ * ScalarEvolution describes an instruction whose value advances by a loop
+ * invariant step on every iteration as the recurrence {Start,+,Step}. Such an
+ * instruction is replaced with a phi of the loop header, initialized to Start
+ * in the preheader and incremented by Step in the latch, which turns e.g. the
+ * multiplication @c i*c into an addition of @c c . Pointers are reduced the
+ * same way, with the increment being the byte offset between consecutive
+ * addresses. The computations that only fed the replaced instruction are
+ * removed afterwards.
+ *
+ * Only the multiplications, shifts and address computations are reduced. An
+ * addition of an invariant to an induction variable is as cheap as the
+ * increment that would replace it, and an address whose only varying index is
+ * a phi of the header is left to the addressing modes of the target.
+ */
+class LoopStrengthReduction final : public LoopPass {
+private:
+  Loop *L;
+  LoopInfo *LI;
+  ScalarEvolution *SE;
+  const TargetTransformInfo *TTI;
+  OptimizationRemarkEmitter *ORE;
+  /// Register pressure of the loop, if the target is known
+  std::unique_ptr<LoopRegPressure> Pressure;
+  /// Induction variable phi of each recurrence
+  DenseMap<const SCEV *, PHINode *> IVs;
+
+  bool isCandidate(const Instruction &Inst) const {
+    switch (Inst.getOpcode()) {
+    case Instruction::Mul:
+    case Instruction::Shl:
+      return true;
+    case Instruction::GetElementPtr:
+      for (const Value *const Idx :
+           cast<GetElementPtrInst>(Inst).indices()) {
+        if (L->isLoopInvariant(Idx)) {
+          continue;
+        }
+        const PHINode *const PHI = dyn_cast<PHINode>(Idx);
+        if (!PHI || PHI->getParent() != L->getHeader()) {
+          return true;
+        }
+      }
+      return false;
+    default:
+      return false;
+    }
+  }
+  /**
+   * @brief Obtain the recurrence of @c Inst if it is affine in the loop and
+   *        its start and step can be computed cheaply in the preheader.
+   */
+  const SCEVAddRecExpr *getAffineRec(Instruction &Inst) const {
+    if (!SE->isSCEVable(Inst.getType())) {
+      return nullptr;
+    }
+    const SCEVAddRecExpr *const AR =
+        dyn_cast<SCEVAddRecExpr>(SE->getSCEV(&Inst));
+    if (!AR || AR->getLoop() != L || !AR->isAffine()) {
+      return nullptr;
+    }
+    const Instruction *const At = L->getLoopPreheader()->getTerminator();
+    SCEVExpander Expander(*SE, At->getModule()->getDataLayout(), "sr");
+    for (const SCEV *const S : {AR->getStart(), AR->getStepRecurrence(*SE)}) {
+      if (!isSafeToExpand(S, *SE) ||
+          Expander.isHighCostExpansion(S, L, ExpansionBudget, TTI, At)) {
+        return nullptr;
+      }
+    }
+    return AR;
+  }
+  /**
+   * @brief Create the induction variable phi that follows @c AR .
+   */
+  PHINode *createIV(const SCEVAddRecExpr &AR, Type *const Ty) {
+    BasicBlock *const Preheader = L->getLoopPreheader();
+    BasicBlock *const Latch = L->getLoopLatch();
+    SCEVExpander Expander(*SE, Preheader->getModule()->getDataLayout(), "sr");
+    Value *const Start = Expander.expandCodeFor(AR.getStart(), Ty,
+                                                Preheader->getTerminator());
+    const SCEV *const StepSCEV = AR.getStepRecurrence(*SE);
+    Value *const Step = Expander.expandCodeFor(
+        StepSCEV, StepSCEV->getType(), Preheader->getTerminator());
+
+    PHINode *const PHI = PHINode::Create(Ty, 2, "sr", &L->getHeader()->front());
+    IRBuilder<> Builder(Latch->getTerminator());
+    Value *Next;
+    if (PointerType *const PtrTy = dyn_cast<PointerType>(Ty)) {
+      // the step of a pointer is in bytes
+      Value *const Bytes = Builder.CreateBitCast(
+          PHI, Builder.getInt8PtrTy(PtrTy->getAddressSpace()));
+      Next = Builder.CreateBitCast(
+          Builder.CreateGEP(Builder.getInt8Ty(), Bytes, Step), Ty, "sr.next");
+    } else {
+      Next = Builder.CreateAdd(PHI, Step, "sr.next");
+    }
+    PHI->addIncoming(Start, Preheader);
+    PHI->addIncoming(Next, Latch);
+    ++NumPhisInserted;
+    return PHI;
+  }
+  /**
+   * @brief Replace @c Inst with the induction variable of its recurrence.
+   */
+  bool reduce(Instruction &Inst) {
+    const SCEVAddRecExpr *const AR = getAffineRec(Inst);
+    if (!AR) {
+      return false;
+    }
+    PHINode *&PHI = IVs[AR];
+    if (!PHI) {
+      // The new phi is live throughout the loop, which only pays off if a
+      // register is left for it.
+      if (Pressure && !Pressure->hasRoomFor(Inst)) {
+        ++NumHighPressure;
+        ORE->emit([&]() {
+          return OptimizationRemarkMissed(DEBUG_TYPE, "RegisterPressure",
+                                          &Inst)
+                 << "not strength reducing " << Inst.getOpcodeName()
+                 << ": no register is left for an induction variable";
+        });
+        return false;
+      }
+      PHI = createIV(*AR, Inst.getType());
+      if (Pressure) {
+        Pressure->addLiveThrough(*PHI);
+      }
+    }
+    ORE->emit([&]() {
+      return OptimizationRemark(DEBUG_TYPE, "StrengthReduced", &Inst)
+             << "replaced " << Inst.getOpcodeName()
+             << " with an induction variable";
+    });
+    LLVM_DEBUG(dbgs() << "LSR: " << Inst << " -> " << *PHI << "\n");
+    SE->forgetValue(&Inst);
+    Inst.replaceAllUsesWith(PHI);
+    RecursivelyDeleteTriviallyDeadInstructions(&Inst);
+    return true;
+  }
+
+public:
+  static char ID;
+
+  LoopStrengthReduction() : LoopPass(ID) {}
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequiredID(LoopSimplifyID);
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<ScalarEvolutionWrapperPass>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
+    AU.addPreserved<ScalarEvolutionWrapperPass>();
+    AU.setPreservesCFG();
+  }
+
+  virtual bool runOnLoop(Loop *const L, LPPassManager &) override {
+    if (!L->getLoopPreheader() || !L->getLoopLatch()) {
+      return false;
+    }
+    Function &F = *L->getHeader()->getParent();
+    this->L = L;
+    LI = &getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    SE = &getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+    TTI = &getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
+    OptimizationRemarkEmitter LoopORE(&F);
+    ORE = &LoopORE;
+    // Without a target, the register count of TTI is a mere placeholder.
+    Pressure.reset(F.getParent()->getTargetTriple().empty()
+                       ? nullptr
+                       : new LoopRegPressure(*L, *TTI));
+    IVs.clear();
+
+    // Visit the users before their operands, so that e.g. an address is
+    // reduced as a whole rather than the multiplication of its index.
+    // The handles only skip the candidates deleted meanwhile, and do not
+    // follow them to their replacements.
+    std::vector<WeakVH> Candidates;
+    for (BasicBlock *const BB : L->getBlocks()) {
+      if (LI->getLoopFor(BB) != L) {
+        continue;
+      }
+      for (Instruction &Inst : *BB) {
+        if (isCandidate(Inst)) {
+          Candidates.emplace_back(&Inst);
+        }
+      }
+    }
+    unsigned NumReducedInLoop = 0;
+    for (WeakVH &Candidate : reverse(Candidates)) {
+      auto *const Inst = dyn_cast_or_null<Instruction>(Candidate);
+      if (Inst && reduce(*Inst)) {
+        ++NumReducedInLoop;
+      }
+    }
+    Pressure.reset();
+    IVs.clear();
+
+    LLVM_DEBUG(dbgs() << "LSR: loop " << L->getHeader()->getName() << ": "
+                      << NumReducedInLoop << " reduced\n");
+    NumReduced += NumReducedInLoop;
+    return NumReducedInLoop != 0;
+  }
+};
+
+char LoopStrengthReduction::ID = 0;
+RegisterPass<LoopStrengthReduction> X("loop-strength-reduction",
+                                      "Loop Induction Variable Strength "
+                                      "Reduction");
+
+} // anonymous namespace
@@ -0,0 +1,213 @@
+/**
+ * @file Loop Unrolling with a Cost Model
+ */
+#include <llvm/ADT/Statistic.h>
+#include <llvm/Analysis/AssumptionCache.h>
+#include <llvm/Analysis/LoopPass.h>
+#include <llvm/Analysis/OptimizationRemarkEmitter.h>
+#include <llvm/Analysis/ScalarEvolution.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/IR/Dominators.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Debug.h>
+#include <llvm/Transforms/Utils.h>
+#include <llvm/Transforms/Utils/LoopUtils.h>
+#include <llvm/Transforms/Utils/UnrollLoop.h>
+
+#include <algorithm>
+
+#include "RegPressure.h"
+
+#define DEBUG_TYPE "loop-unrolling"
+
+STATISTIC(NumFullyUnrolled, "Number of loops fully unrolled");
+STATISTIC(NumPartiallyUnrolled, "Number of loops partially unrolled");
+STATISTIC(NumRemainders, "Number of remainder loops created by unrolling");
+
+static cl::opt<unsigned> FullThreshold(
+    "loop-unrolling-full-threshold", cl::init(256), cl::Hidden,
+    cl::desc("Maximum size of a fully unrolled loop, that is, the size of its "
+             "body times its trip count"));
+static cl::opt<unsigned> PartialThreshold(
+    "loop-unrolling-partial-threshold", cl::init(128), cl::Hidden,
+    cl::desc("Maximum size of the body of a partially unrolled loop"));
+static cl::opt<unsigned> MaxCount(
+    "loop-unrolling-max-count", cl::init(8), cl::Hidden,
+    cl::desc("Maximum unrolling factor of a partially unrolled loop"));
+
+namespace {
+
+/**
+ * @brief Unrolling of innermost loops, driven by the trip count, the size of
+ *        the body and the register pressure.
+ *
+ * A loop whose trip count is a known constant is fully unrolled if the
+ * straight-line code stays below @c FullThreshold . Otherwise the body is
+ * copied as many times as @c PartialThreshold and @c MaxCount allow, where
+ * the copies must also fit in the registers next to each other, as the
+ * scheduler is free to interleave them. The factor is a power of two, and the
+ * iterations left over, if the trip count is unknown or not a multiple of the
+ * factor, run in a remainder loop after the unrolled one. A trip count
+ * estimated from the profile further bounds the factor.
+ */
+class LoopUnrolling final : public LoopPass {
+private:
+  /**
+   * @brief Size of the body of @c L , or @c UINT_MAX if it cannot be copied.
+   */
+  static unsigned getLoopSize(const Loop &L, const TargetTransformInfo &TTI) {
+    if (!L.isSafeToClone()) {
+      return UINT_MAX;
+    }
+    InstructionCost Size = 0;
+    for (const BasicBlock *const BB : L.getBlocks()) {
+      for (const Instruction &Inst : *BB) {
+        const CallBase *const Call = dyn_cast<CallBase>(&Inst);
+        if (Call && Call->isConvergent()) {
+          return UINT_MAX;
+        }
+        Size += TTI.getUserCost(&Inst, TargetTransformInfo::TCK_CodeSize);
+      }
+    }
+    return Size.isValid() ? std::max<unsigned>(*Size.getValue(), 1)
+                          : UINT_MAX;
+  }
+
+public:
+  static char ID;
+
+  LoopUnrolling() : LoopPass(ID) {}
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const override {
+    AU.addRequiredID(LoopSimplifyID);
+    AU.addRequiredID(LCSSAID);
+    AU.addRequired<AssumptionCacheTracker>();
+    AU.addRequired<DominatorTreeWrapperPass>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    AU.addRequired<ScalarEvolutionWrapperPass>();
+    AU.addRequired<TargetTransformInfoWrapperPass>();
+    AU.addPreservedID(LCSSAID);
+    AU.addPreserved<DominatorTreeWrapperPass>();
+    AU.addPreserved<LoopInfoWrapperPass>();
+    AU.addPreserved<ScalarEvolutionWrapperPass>();
+  }
+
+  virtual bool runOnLoop(Loop *const L, LPPassManager &LPM) override {
+    if (!L->isInnermost() || !L->isLoopSimplifyForm() ||
+        getBooleanLoopAttribute(L, "llvm.loop.unroll.disable")) {
+      return false;
+    }
+    Function &F = *L->getHeader()->getParent();
+    DominatorTree &DT = getAnalysis<DominatorTreeWrapperPass>().getDomTree();
+    LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    ScalarEvolution &SE = getAnalysis<ScalarEvolutionWrapperPass>().getSE();
+    const TargetTransformInfo &TTI =
+        getAnalysis<TargetTransformInfoWrapperPass>().getTTI(F);
+    AssumptionCache &AC =
+        getAnalysis<AssumptionCacheTracker>().getAssumptionCache(F);
+    OptimizationRemarkEmitter ORE(&F);
+
+    const unsigned LoopSize = getLoopSize(*L, TTI);
+    if (LoopSize == UINT_MAX) {
+      return false;
+    }
+    // Only the latch may exit the loop, so that each copy of the body either
+    // continues with the next one or leaves through the last.
+    BasicBlock *const ExitingBB = L->getExitingBlock();
+    if (!ExitingBB || ExitingBB != L->getLoopLatch()) {
+      return false;
+    }
+    const unsigned TripCount = SE.getSmallConstantTripCount(L, ExitingBB);
+    const unsigned TripMultiple = SE.getSmallConstantTripMultiple(L, ExitingBB);
+
+    unsigned Count;
+    if (TripCount != 0 && LoopSize * TripCount <= FullThreshold) {
+      Count = TripCount;
+    } else {
+      Count = std::min<unsigned>(MaxCount, PartialThreshold / LoopSize);
+      if (Optional<unsigned> EstimatedTripCount = getLoopEstimatedTripCount(L)) {
+        Count = std::min(Count, *EstimatedTripCount);
+      }
+      // Without a target, the register count of TTI is a mere placeholder.
+      if (!F.getParent()->getTargetTriple().empty()) {
+        const unsigned MaxCopies = LoopRegPressure(*L, TTI).getMaxCopies();
+        if (MaxCopies < Count) {
+          ORE.emit([&]() {
+            return OptimizationRemarkMissed(DEBUG_TYPE, "RegisterPressure",
+                                            L->getStartLoc(), L->getHeader())
+                   << "reducing the unrolling factor from "
+                   << ore::NV("UnrollCount", Count) << " to "
+                   << ore::NV("MaxCopies", MaxCopies)
+                   << " due to register pressure";
+          });
+          Count = MaxCopies;
+        }
+      }
+      // round down to a power of two, which makes the remainder a mask
+      while (Count & (Count - 1)) {
+        Count &= Count - 1;
+      }
+      if (Count < 2) {
+        return false;
+      }
+    }
+
+    const bool FullyUnrolling = Count == TripCount;
+    // The remainder loop is also used if the trip count is constant, but not
+    // a multiple of the factor.
+    const bool NeedsRemainder = !FullyUnrolling && TripMultiple % Count != 0;
+    UnrollLoopOptions ULO;
+    ULO.Count = Count;
+    ULO.TripCount = NeedsRemainder ? 0 : TripCount;
+    ULO.Force = false;
+    ULO.AllowRuntime = NeedsRemainder;
+    ULO.AllowExpensiveTripCount = false;
+    ULO.PreserveCondBr = false;
+    ULO.PreserveOnlyFirst = false;
+    ULO.TripMultiple = NeedsRemainder ? 1 : TripMultiple;
+    ULO.PeelCount = 0;
+    ULO.UnrollRemainder = false;
+    ULO.ForgetAllSCEV = false;
+    Loop *RemainderLoop = nullptr;
+    const DebugLoc Loc = L->getStartLoc();
+    BasicBlock *const Header = L->getHeader();
+    const LoopUnrollResult Result =
+        UnrollLoop(L, ULO, &LI, &SE, &DT, &AC, &TTI, &ORE,
+                   /* PreserveLCSSA= */ true, &RemainderLoop);
+    if (Result == LoopUnrollResult::Unmodified) {
+      return false;
+    }
+
+    if (Result == LoopUnrollResult::FullyUnrolled) {
+      ++NumFullyUnrolled;
+      ORE.emit([&]() {
+        return OptimizationRemark(DEBUG_TYPE, "FullyUnrolled", Loc, Header)
+               << "completely unrolled a loop of "
+               << ore::NV("TripCount", TripCount) << " iterations";
+      });
+      LLVM_DEBUG(dbgs() << "Unroll: fully unrolled " << TripCount
+                        << " iterations of size " << LoopSize << "\n");
+      LPM.markLoopAsDeleted(*L);
+      return true;
+    }
+    ++NumPartiallyUnrolled;
+    NumRemainders += RemainderLoop != nullptr;
+    ORE.emit([&]() {
+      return OptimizationRemark(DEBUG_TYPE, "PartiallyUnrolled", Loc, Header)
+             << "unrolled a loop by a factor of "
+             << ore::NV("UnrollCount", Count)
+             << (RemainderLoop ? " with a remainder loop" : "");
+    });
+    LLVM_DEBUG(dbgs() << "Unroll: unrolled by " << Count << ", size "
+                      << LoopSize << (RemainderLoop ? ", remainder" : "")
+                      << "\n");
+    L->setLoopAlreadyUnrolled();
+    return true;
+  }
+};
+
+char LoopUnrolling::ID = 0;
+RegisterPass<LoopUnrolling> X("loop-unrolling",
+                              "Loop Unrolling with a Cost Model");
+
+} // anonymous namespace
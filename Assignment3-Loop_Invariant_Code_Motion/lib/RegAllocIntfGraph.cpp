@@ -1,26 +1,39 @@
 /**
  * @file Interference Graph Register Allocator
  */
+#include <llvm/ADT/BitVector.h>
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/EquivalenceClasses.h>
+#include <llvm/ADT/SetVector.h>
+#include <llvm/ADT/SmallSet.h>
+#include <llvm/ADT/Statistic.h>
 #include <llvm/Analysis/AliasAnalysis.h>
+#include <llvm/CodeGen/CalcSpillWeights.h>
 #include <llvm/CodeGen/LiveIntervals.h>
 #include <llvm/CodeGen/LiveRangeEdit.h>
 #include <llvm/CodeGen/LiveRegMatrix.h>
 #include <llvm/CodeGen/LiveStacks.h>
 #include <llvm/CodeGen/MachineBlockFrequencyInfo.h>
 #include <llvm/CodeGen/MachineDominators.h>
+#include <llvm/CodeGen/MachineFrameInfo.h>
 #include <llvm/CodeGen/MachineFunctionPass.h>
 #include <llvm/CodeGen/MachineLoopInfo.h>
 #include <llvm/CodeGen/MachineRegisterInfo.h>
+#include <llvm/CodeGen/PseudoSourceValue.h>
 #include <llvm/CodeGen/RegAllocRegistry.h>
 #include <llvm/CodeGen/RegisterClassInfo.h>
 #include <llvm/CodeGen/Spiller.h>
+#include <llvm/CodeGen/TargetFrameLowering.h>
+#include <llvm/CodeGen/TargetInstrInfo.h>
 #include <llvm/CodeGen/TargetRegisterInfo.h>
 #include <llvm/CodeGen/VirtRegMap.h>
 #include <llvm/InitializePasses.h>
+#include <llvm/Support/CommandLine.h>
+#include <llvm/Support/Debug.h>
+#include <llvm/Support/ThreadPool.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Target/TargetMachine.h>
 
-#include <cmath>
 #include <queue>
 #include <tuple>
 #include <unordered_map>
@@ -28,9 +41,38 @@
 
 using namespace llvm;
 
+#define DEBUG_TYPE "regallointfgraph"
+
+STATISTIC(NumCoalesced, "Number of copies coalesced");
+STATISTIC(NumMovesLeft, "Number of copies left as moves after allocation");
+STATISTIC(NumOptimistic, "Number of potential spills colored optimistically");
+STATISTIC(NumActualSpills, "Number of live intervals spilled");
+STATISTIC(NumSpillStores, "Number of stores to spill slots left");
+STATISTIC(NumReloads, "Number of reloads from spill slots left");
+STATISTIC(NumRemats, "Number of values recomputed instead of reloaded");
+STATISTIC(NumSlotsMerged, "Number of spill slots merged into others");
+STATISTIC(NumSlotBytesSaved, "Number of bytes of spill slots saved");
+STATISTIC(NumLoopSplits, "Number of live intervals split around a loop");
+STATISTIC(NumBlockSplits,
+          "Number of live intervals split around their uses in each block");
+
+static cl::opt<bool> EnableCoalescing(
+    "intfgraph-coalescing", cl::init(true), cl::Hidden,
+    cl::desc("Conservatively coalesce the copies between virtual registers "
+             "before coloring the interference graph"));
+static cl::opt<unsigned> NumColoringThreads(
+    "intfgraph-threads", cl::init(0), cl::Hidden,
+    cl::desc("Number of threads building and coloring the graphs of the "
+             "register files in parallel (0 = hardware concurrency, "
+             "1 = sequential)"));
+static cl::opt<bool> ReportAllocation(
+    "intfgraph-report", cl::init(false), cl::Hidden,
+    cl::desc("Print a summary of the allocation of each function"));
+
 namespace llvm {
 
 void initializeRAIntfGraphPass(PassRegistry &Registry);
+void initializeRALinearScanPass(PassRegistry &Registry);
 
 } // namespace llvm
 
@@ -43,37 +85,232 @@ struct hash<Register> {
   }
 };
 
-template <> //
-struct greater<LiveInterval *> {
-  bool operator()(LiveInterval *const &LHS, LiveInterval *const &RHS) {
-    /**
-     * @TODO(cscd70) Please finish the implementation of this function that is
-     *               used for determining whether one live interval has spill
-     *               cost greater than the other.
-     */
-    return LHS->weight() > RHS->weight();
+} // namespace std
+
+namespace {
+
+/**
+ * @brief Report the pairs of overlapping live ranges by sweeping their
+ *        segments in the order of the slot indexes.
+ *
+ * The active segments, i.e., those covering the start of the current one, are
+ * ordered by their ends so that the expired ones are dropped first. Each
+ * segment is only compared with the active ones, hence the work grows with the
+ * number of segments and of actual overlaps rather than with the square of the
+ * number of live ranges.
+ *
+ * @param NumNew    Number of new live ranges at the front of @c LRs . The
+ *                  overlaps between two of the others are not reported.
+ * @param Callback  Called with the indexes of the two live ranges in @c LRs ,
+ *                  possibly more than once per pair
+ */
+template <typename CallbackT>
+void forEachOverlap(ArrayRef<const LiveRange *> LRs, const size_t NumNew,
+                    CallbackT Callback) {
+  std::vector<std::pair<const LiveRange::Segment *, size_t>> Segments;
+  for (size_t LRIdx = 0; LRIdx < LRs.size(); ++LRIdx) {
+    for (const LiveRange::Segment &Seg : *LRs[LRIdx]) {
+      Segments.emplace_back(&Seg, LRIdx);
+    }
+  }
+  llvm::sort(Segments, [](const auto &LHS, const auto &RHS) {
+    return LHS.first->start < RHS.first->start;
+  });
+  // end of each active segment -> index of its live interval
+  std::multimap<SlotIndex, size_t> Active;
+  for (const auto &SegIdxPair : Segments) {
+    const LiveRange::Segment &Seg = *SegIdxPair.first;
+    const size_t LRIdx = SegIdxPair.second;
+    Active.erase(Active.begin(), Active.upper_bound(Seg.start));
+    for (const auto &EndIdxPair : Active) {
+      if (EndIdxPair.second != LRIdx &&
+          (LRIdx < NumNew || EndIdxPair.second < NumNew)) {
+        Callback(EndIdxPair.second, LRIdx);
+      }
+    }
+    Active.emplace(Seg.end, LRIdx);
+  }
+}
+
+/**
+ * @brief Triangular bit matrix of the interferences among the virtual
+ *        registers of one register file.
+ *
+ * Node i owns the bits [i*(i-1)/2, i*(i+1)/2), one for each node before it,
+ * hence new nodes, e.g., those of split registers, only extend the matrix.
+ */
+class IntfMatrix {
+private:
+  BitVector Bits;
+  unsigned NumNodes = 0;
+  size_t NumEdges = 0;
+
+  static size_t getBitIdx(unsigned Row, unsigned Col) {
+    if (Row < Col) {
+      std::swap(Row, Col);
+    }
+    return static_cast<size_t>(Row) * (Row - 1) / 2 + Col;
+  }
+
+public:
+  unsigned addNode() {
+    Bits.resize(static_cast<size_t>(NumNodes + 1) * NumNodes / 2);
+    return NumNodes++;
+  }
+  bool test(const unsigned A, const unsigned B) const {
+    return A != B && Bits.test(getBitIdx(A, B));
+  }
+  /// @return Whether the edge is new
+  bool set(const unsigned A, const unsigned B) {
+    if (test(A, B)) {
+      return false;
+    }
+    Bits.set(getBitIdx(A, B));
+    ++NumEdges;
+    return true;
+  }
+  void reset(const unsigned A, const unsigned B) {
+    if (test(A, B)) {
+      Bits.reset(getBitIdx(A, B));
+      --NumEdges;
+    }
   }
+  unsigned getNumNodes() const { return NumNodes; }
+  size_t getNumEdges() const { return NumEdges; }
+  size_t getMemorySize() const { return Bits.getMemorySize(); }
 };
 
-} // namespace std
+/**
+ * @brief Binary max-heap of virtual registers keyed by spill priority.
+ *
+ * The position of each register in the heap is recorded, so that the priority
+ * of any of them can be raised or lowered, or the register removed, in
+ * O(log n) while keeping the heap ordered. Equal priorities are broken by the
+ * register number, which keeps the allocation order deterministic.
+ */
+class RegPriorityQueue {
+private:
+  using Entry_t = std::pair<float, Register>;
+  std::vector<Entry_t> Heap;
+  /// Position of each virtual register in the heap, indexed by its number
+  std::vector<unsigned> Positions;
 
-namespace {
+  static bool isHigher(const Entry_t &LHS, const Entry_t &RHS) {
+    return LHS.first > RHS.first ||
+           (LHS.first == RHS.first && LHS.second < RHS.second);
+  }
+  unsigned &getPosition(const Register &Reg) {
+    const unsigned Idx = Register::virtReg2Index(Reg);
+    if (Idx >= Positions.size()) {
+      Positions.resize(Idx + 1, ~0U);
+    }
+    return Positions[Idx];
+  }
+  void place(const unsigned Pos, Entry_t Entry) {
+    getPosition(Entry.second) = Pos;
+    Heap[Pos] = std::move(Entry);
+  }
+  void siftUp(unsigned Pos) {
+    Entry_t Entry = Heap[Pos];
+    while (Pos != 0 && isHigher(Entry, Heap[(Pos - 1) / 2])) {
+      place(Pos, Heap[(Pos - 1) / 2]);
+      Pos = (Pos - 1) / 2;
+    }
+    place(Pos, std::move(Entry));
+  }
+  void siftDown(unsigned Pos) {
+    Entry_t Entry = Heap[Pos];
+    for (unsigned Child = 2 * Pos + 1; Child < Heap.size();
+         Child = 2 * Pos + 1) {
+      if (Child + 1 < Heap.size() && isHigher(Heap[Child + 1], Heap[Child])) {
+        ++Child;
+      }
+      if (!isHigher(Heap[Child], Entry)) {
+        break;
+      }
+      place(Pos, Heap[Child]);
+      Pos = Child;
+    }
+    place(Pos, std::move(Entry));
+  }
+
+public:
+  bool empty() const { return Heap.empty(); }
+  size_t size() const { return Heap.size(); }
+  bool contains(const Register &Reg) const {
+    const unsigned Idx = Register::virtReg2Index(Reg);
+    return Idx < Positions.size() && Positions[Idx] != ~0U;
+  }
+  /// The register of the highest priority
+  Register top() const { return Heap.front().second; }
+  /// Insert @c Reg , or change its priority if it is already in the heap.
+  void update(const Register &Reg, const float Priority) {
+    if (!contains(Reg)) {
+      Heap.emplace_back(Priority, Reg);
+      getPosition(Reg) = Heap.size() - 1;
+      siftUp(Heap.size() - 1);
+      return;
+    }
+    const unsigned Pos = getPosition(Reg);
+    const float OldPriority = Heap[Pos].first;
+    Heap[Pos].first = Priority;
+    if (Priority > OldPriority) {
+      siftUp(Pos);
+    } else {
+      siftDown(Pos);
+    }
+  }
+  void erase(const Register &Reg) {
+    if (!contains(Reg)) {
+      return;
+    }
+    const unsigned Pos = getPosition(Reg);
+    getPosition(Reg) = ~0U;
+    Entry_t Last = Heap.back();
+    Heap.pop_back();
+    if (Pos == Heap.size()) {
+      return;
+    }
+    place(Pos, Last);
+    // the last entry moves either up or down from the hole
+    siftUp(Pos);
+    siftDown(getPosition(Last.second));
+  }
+  void clear() {
+    Heap.clear();
+    Positions.clear();
+  }
+  /// Iterate over the registers in the heap, in no particular order.
+  auto regs() const {
+    return map_range(Heap,
+                     [](const Entry_t &Entry) { return Entry.second; });
+  }
+};
 
-class RAIntfGraph;
+class RABase;
 
 class AllocationHints {
 private:
   SmallVector<MCPhysReg, 16> Hints;
 
 public:
-  AllocationHints(RAIntfGraph *const RA, const LiveInterval *const LI);
+  AllocationHints(RABase *const RA, const LiveInterval *const LI);
+  /**
+   * @brief Move to the front the physical registers that the copies of
+   *        @c LI move from or to, the most frequent first, so that these
+   *        copies become identities (biased coloring).
+   */
+  void biasTowardsCopies(RABase *const RA, const LiveInterval *const LI);
   SmallVectorImpl<MCPhysReg>::iterator begin() { return Hints.begin(); }
   SmallVectorImpl<MCPhysReg>::iterator end() { return Hints.end(); }
 };
 
-class RAIntfGraph final : public MachineFunctionPass,
-                          private LiveRangeEdit::Delegate {
-private:
+/**
+ * @brief Analyses, spiller and post-allocation steps shared by the register
+ *        allocators of this file.
+ */
+class RABase : public MachineFunctionPass {
+protected:
   MachineFunction *MF;
 
   SlotIndexes *SI;
@@ -83,7 +320,99 @@ private:
   RegisterClassInfo RCI;
   LiveRegMatrix *LRM;
   MachineLoopInfo *MLI;
+  MachineBlockFrequencyInfo *MBFI;
   LiveIntervals *LIS;
+  LiveStacks *LSS;
+
+  SmallPtrSet<MachineInstr *, 32> DeadRemats;
+  std::unique_ptr<Spiller> SpillerInst;
+  /// Number of values rematerialized by the spills in the current function
+  unsigned NumRematsInFunc = 0;
+
+  /**
+   * @brief Fetch the analyses of @c MF and create the spiller.
+   */
+  void init(MachineFunction &MF);
+  /**
+   * @brief Spill @c LI on behalf of the allocator @c Delegate , which leaves
+   *        the new live intervals, e.g., around the reloads, in @c NewRegs .
+   */
+  void spill(LiveInterval &LI, LiveRangeEdit::Delegate &Delegate,
+             SmallVectorImpl<Register> &NewRegs);
+  /**
+   * @brief Count the rematerializations among the registers @c NewRegs
+   *        created by a spill, i.e., those defined by a trivially
+   *        rematerializable instruction other than the spilled definition,
+   *        which is stored right away.
+   */
+  unsigned countRemats(ArrayRef<Register> NewRegs) const;
+  /**
+   * @brief Count the copies that move a value between two different
+   *        registers, assuming the virtual ones are assigned as in @c VRM .
+   *
+   * @return The static number of moves and their execution frequency,
+   *         relative to the entry block
+   */
+  std::pair<unsigned, double> countMoves() const;
+  /**
+   * @brief Count the stores to the spill slots and the reloads from them.
+   */
+  std::pair<unsigned, unsigned> countSpillCode() const;
+  /**
+   * @brief Share the spill slots whose live ranges in @c LiveStacks do not
+   *        overlap (stack slot coloring), which shrinks the frame.
+   *
+   * The slots are colored greedily, the most frequently accessed first, so
+   * that the hot ones keep their places and the cold ones move in with them.
+   * A shared slot is as large and as aligned as the largest of its members.
+   */
+  void colorSpillSlots();
+  /**
+   * @brief Clean up after the spiller and shrink the frame.
+   */
+  void postOptimization();
+  /**
+   * @brief Print the spill code left in the current function.
+   */
+  void reportSpillCode();
+
+  friend class AllocationHints;
+
+public:
+  explicit RABase(char &ID) : MachineFunctionPass(ID) {}
+
+  void getAnalysisUsage(AnalysisUsage &AU) const override {
+    MachineFunctionPass::getAnalysisUsage(AU);
+    AU.setPreservesCFG();
+#define REQUIRE_AND_PRESERVE_PASS(PassName)                                    \
+  AU.addRequired<PassName>();                                                  \
+  AU.addPreserved<PassName>()
+
+    REQUIRE_AND_PRESERVE_PASS(SlotIndexes);
+    REQUIRE_AND_PRESERVE_PASS(VirtRegMap);
+    REQUIRE_AND_PRESERVE_PASS(LiveIntervals);
+    REQUIRE_AND_PRESERVE_PASS(LiveRegMatrix);
+    REQUIRE_AND_PRESERVE_PASS(LiveStacks);
+    REQUIRE_AND_PRESERVE_PASS(AAResultsWrapperPass);
+    REQUIRE_AND_PRESERVE_PASS(MachineDominatorTree);
+    REQUIRE_AND_PRESERVE_PASS(MachineLoopInfo);
+    REQUIRE_AND_PRESERVE_PASS(MachineBlockFrequencyInfo);
+  }
+
+  MachineFunctionProperties getRequiredProperties() const override {
+    return MachineFunctionProperties().set(
+        MachineFunctionProperties::Property::NoPHIs);
+  }
+  MachineFunctionProperties getClearedProperties() const override {
+    return MachineFunctionProperties().set(
+        MachineFunctionProperties::Property::IsSSA);
+  }
+}; // class RABase
+
+class RAIntfGraph final : public RABase, private LiveRangeEdit::Delegate {
+private:
+  /// Threads that process the register files in parallel, if any
+  std::unique_ptr<ThreadPool> Pool;
 
   /**
    * @brief Interference Graph
@@ -93,24 +422,245 @@ private:
     RAIntfGraph *RA;
 	
 	std::unordered_map<Register, float> weightMap;
-	std::unordered_set<MCPhysReg> assignedPhysReg;
 
-    /// Interference Relations
-    std::multimap<LiveInterval *, std::unordered_set<Register>,
-                  std::greater<LiveInterval *>>
-        IntfRels;
+    /**
+     * @brief Node of a virtual register in the interference graph.
+     *
+     * The graph has the dual representation of Chaitin-Briggs: the bit matrix
+     * of the register file answers whether two registers interfere in
+     * constant time, while the neighbors are enumerated from a compact
+     * adjacency vector.
+     */
+    struct Node {
+      /// Register file, i.e., the matrix the node belongs to
+      unsigned File = ~0U;
+      /// Number of the node in the matrix of its register file
+      unsigned Num = 0;
+      /// Whether the node is still to be materialized
+      bool InGraph = false;
+      /// Number of neighbors still to be materialized
+      unsigned Degree = 0;
+      /// Number of registers of the class left to the node by the physical
+      /// registers live across it, the calls that clobber registers and the
+      /// neighbors colored in earlier rounds
+      unsigned NumColors = 0;
+      SmallVector<Register, 8> Neighbors;
+      /// Precolored neighbors, i.e., the register units whose fixed live
+      /// ranges overlap the node, e.g., those of the argument registers
+      SmallVector<unsigned, 4> FixedUnits;
+      /// Physical registers to select from, in the order of the hints, not
+      /// clobbered by the calls that the node is live across
+      SmallVector<MCPhysReg, 16> Candidates;
+      /// Virtual registers of the file that the node is copied from or to,
+      /// the most frequent copies first
+      SmallVector<std::pair<double, Register>, 2> CopyPartners;
+      /// Physical register selected for the node, if any
+      MCPhysReg Color = 0;
+    };
+    /// Nodes indexed by virtual register number
+    std::vector<Node> VRegNodes;
+    /// Matrix of each register file, i.e., the register classes that share
+    /// register units and hence compete for the same physical registers
+    std::vector<IntfMatrix> Matrices;
+    /// Register file of each register unit
+    DenseMap<unsigned, unsigned> UnitFiles;
+    /// Register units of each file with a fixed live range, the precolored
+    /// nodes of the file
+    std::vector<SmallVector<std::pair<unsigned, const LiveRange *>, 8>>
+        FixedRanges;
+
+    /**
+     * @brief Add the nodes of the virtual registers created since the last
+     *        call.
+     *
+     * The nodes are never added by the tasks of @c forEachFile , as growing
+     * them would move those that the other threads hold references to.
+     */
+    void growNodes() {
+      if (VRegNodes.size() < RA->MRI->getNumVirtRegs()) {
+        VRegNodes.resize(RA->MRI->getNumVirtRegs());
+      }
+    }
+    Node &getNode(const Register &Reg) {
+      const unsigned Idx = Register::virtReg2Index(Reg);
+      assert(Idx < VRegNodes.size() && "node of a register not grown yet");
+      return VRegNodes[Idx];
+    }
+    unsigned getRegFile(const TargetRegisterClass &RC);
+    /// Add a new register file of the register units @c Units .
+    template <typename UnitRangeT> unsigned addRegFile(UnitRangeT Units);
+    /// Group the register classes of all the virtual registers into files.
+    void computeRegFiles();
+    void addEdge(const Register &A, const Register &B);
+    void addFixedEdge(const Register &Reg, const unsigned Unit);
+    void removeEdges(const Register &Reg);
+    /// Whether two virtual registers interfere in the graph
+    bool interferes(const Register &A, const Register &B);
+    /// Number of copies coalesced in the current function
+    unsigned NumCoalescedInFunc = 0;
+    /**
+     * @brief Check whether merging @c Src into @c Dst keeps the graph
+     *        colorable, by the tests of Briggs and George.
+     */
+    bool canCoalesce(const Register &Dst, const Register &Src,
+                     const TargetRegisterClass &RC);
+    /**
+     * @brief Merge @c Src into @c Dst , in the code, the live intervals and
+     *        the graph, and delete the copies that have become identities.
+     */
+    void merge(const Register &Dst, const Register &Src,
+               const TargetRegisterClass &RC,
+               SmallPtrSetImpl<MachineInstr *> &Erased);
+    /**
+     * @brief Coalesce the copies between the virtual registers of the graph,
+     *        the most frequent first.
+     */
+    void coalesce();
+
+    /// Interference Relations of each register file, i.e., the nodes still
+    /// in the graph in the order of their spill priorities, the best
+    /// candidate to spill on top
+    std::vector<RegPriorityQueue> IntfRels;
+    RegPriorityQueue &getQueue(const Register &Reg) {
+      return IntfRels[getNode(Reg).File];
+    }
+    /**
+     * @brief Run @c Task on each of the register files @c Files , in
+     *        parallel if there is a thread pool.
+     *
+     * The files share no register units, hence their graphs are disjoint.
+     * Each task must only touch the nodes, the matrix and the queue of its
+     * own file, and leave the analyses, which are not thread-safe, alone.
+     * The nodes are grown before the tasks start, and never by the tasks.
+     */
+    template <typename TaskT>
+    void forEachFile(ArrayRef<unsigned> Files, TaskT Task);
+
+    /// Number of registers available to @c Reg , i.e., the number of colors
+    unsigned getNumColors(const Register &Reg) {
+      return getNode(Reg).NumColors;
+    }
+    void computeNumColors(LiveInterval &LI);
+    /**
+     * @brief Mark in @c Blocked the register units taken by the precolored
+     *        neighbors of @c Reg and by its colored ones.
+     */
+    void collectBlockedUnits(const Register &Reg, BitVector &Blocked);
+    bool isBlocked(const MCPhysReg PhysReg, const BitVector &Blocked) const;
+    /**
+     * @brief Remove all the nodes from the graph (simplify), those of degree
+     *        less than their number of colors first.
+     *
+     * If only nodes of significant degree are left, the one on top of the
+     * queue of @c File is removed as a potential spill, in the hope that its
+     * neighbors will not use all the colors in the end.
+     *
+     * @return The nodes of @c File in the order of their removal
+     */
+    std::vector<Register> simplify(const unsigned File, raw_ostream &OS);
+    /**
+     * @brief Compute the candidates and the copy partners of @c LI , ahead
+     *        of the selection, as they query @c LiveRegMatrix .
+     */
+    void prepareSelect(LiveInterval &LI);
+    /**
+     * @brief Select a color for @c Reg among its candidates that no neighbor
+     *        overlaps, the one of a copy partner if possible.
+     *
+     * @param Blocked  Scratch set of the register units taken
+     */
+    MCPhysReg selectColor(const Register &Reg, BitVector &Blocked,
+                          raw_ostream &OS);
+    /**
+     * @brief Simplify and select the graph of @c File , without assigning
+     *        anything yet.
+     *
+     * @return The nodes of @c File in the order of their selection
+     */
+    std::vector<Register> colorFile(const unsigned File, raw_ostream &OS);
+    /**
+     * @brief Decide what to spill when @c LI cannot be colored, which is
+     *        @c LI itself unless it cannot be spilled, in which case the
+     *        interferences on one of its registers are spilled instead.
+     */
+    void collectSpills(LiveInterval *const LI,
+                       SetVector<LiveInterval *> &Spills);
+
+    /// Registers that have been split, or created by splitting, which are
+    /// spilled rather than split again when they cannot be colored
+    DenseSet<Register> SplitRegs;
+    /**
+     * @brief Move the part of @c Reg in the basic blocks @c InRegion to a new
+     *        register, with copies at the edges where it enters and leaves
+     *        the region, and recompute the live intervals of both.
+     *
+     * The parts descend from the original register of @c Reg in @c VirtRegMap
+     * , whose live interval is left intact, so that the spiller treats them
+     * as siblings and rematerializes them from the original definitions.
+     * Hence, if @c Reg is itself the original, the remainder outside of the
+     * region moves to a new register as well.
+     *
+     * @param EntryPoints  Positions of the copies into the new register
+     * @param ExitPoints   Positions of the copies back into the remainder
+     *
+     * @return The registers of the region part and of the remainder
+     */
+    using InsertPoint_t =
+        std::pair<MachineBasicBlock *, MachineBasicBlock::iterator>;
+    template <typename InRegionT>
+    std::pair<Register, Register>
+    splitRegion(const Register &Reg, InRegionT InRegion,
+                ArrayRef<InsertPoint_t> EntryPoints,
+                ArrayRef<InsertPoint_t> ExitPoints);
+    /**
+     * @brief Check whether the part of @c Reg in the basic blocks @c Region
+     *        would likely be colored, i.e., whether fewer of its neighbors
+     *        than its colors are used there. The neighbors merely live
+     *        through the region can be split or spilled out of it as well.
+     */
+    bool isColorableIn(const Register &Reg,
+                       ArrayRef<MachineBasicBlock *> Region);
+    /**
+     * @brief Split @c LI around the loop @c L , if it is live across the
+     *        boundary of the loop and the loop has a preheader and dedicated
+     *        exits.
+     */
+    bool splitAroundLoop(LiveInterval &LI, MachineLoop &L);
+    /**
+     * @brief Split @c LI around its uses in each basic block it is live into
+     *        or out of.
+     */
+    bool splitAroundBlocks(LiveInterval &LI);
+    /**
+     * @brief Split @c LI before spilling it, so that the register can be kept
+     *        where the code runs the most and the spill code goes elsewhere.
+     *
+     * The split is around the innermost loop of the most frequent use, or the
+     * closest of its parents that can be split around, and otherwise around
+     * the uses in each basic block. The region part competes for a register
+     * with a cost of its own, while the remainder, now cold, is the first to
+     * be spilled.
+     *
+     * @return Whether @c LI has been split, in which case it is gone
+     */
+    bool trySplit(LiveInterval &LI);
 
     /**
-     * @brief  Try to materialize all the virtual registers (internal).
+     * @brief  Try to materialize all the virtual registers (internal), by
+     *         coloring them in the reverse order of @c simplify (select).
+     *
+     * The register files are colored in parallel, after which the colors
+     * are assigned in @c LiveRegMatrix in a fixed order.
      *
-     * @return (nullptr, VirtPhysRegMap) in the case when a successful
-     *         materialization is made, (LI, *) in the case when unsuccessful
-     *         (and LI is the live interval to spill)
+     * @return (∅, VirtPhysRegMap) in the case when a successful
+     *         materialization is made, (LIs, ∅) in the case when unsuccessful
+     *         (and LIs are the live intervals to spill, the graph being empty
+     *         and the colored nodes staying assigned)
      *
      * @sa tryMaterializeAll
      */
     using MaterializeResult_t =
-        std::tuple<LiveInterval *,
+        std::tuple<SmallVector<LiveInterval *, 4>,
                    std::unordered_map<LiveInterval *, MCPhysReg>>;
     MaterializeResult_t tryMaterializeAllInternal();
 
@@ -119,30 +669,39 @@ private:
     /**
      * @brief Insert a virtual register @c Reg into the interference graph.
      */
-    void insert(const Register &Reg);
+    void insert(const Register &Reg) { insert(makeArrayRef(Reg)); }
+    /**
+     * @brief Insert the virtual registers @c Regs into the interference graph,
+     *        connecting them with each other and with the existing nodes.
+     */
+    void insert(ArrayRef<Register> Regs);
     /**
      * @brief Erase a virtual register @c Reg from the interference graph.
      *
+     * @param OS  Where the removal is logged, a buffer of the file while the
+     *            files are colored in parallel
+     *
      * @sa RAIntfGraph::LRE_CanEraseVirtReg
      */
-    void erase(const Register &Reg);
+    void erase(const Register &Reg, raw_ostream &OS = outs());
+    /**
+     * @brief Undo the assignment of @c LI , which is to be spilled, erased or
+     *        inserted again.
+     */
+    void evict(LiveInterval &LI) {
+      growNodes();
+      RA->LRM->unassign(LI);
+      getNode(LI.reg()).Color = 0;
+    }
 
 	/*
-	 * @brief initialize cost to be (#defs & uses) * 10**loop_nest_depth 
+	 * @brief initialize cost to be the block frequency of the defs & uses,
+	 *        normalized by the size of the live interval
  	 */
 	void initializeWeight(const Register &Reg);
 	
 	inline void updateWeight(LiveInterval &node);
 
-	/**
-	 * @brief Allocate a physical register for @c LI, or have the spiller splits
-	 * 		  it into a list of virtual registers
-	 */
-	MCRegister selectOrSplit(LiveInterval *const LI,
-							 SmallVectorImpl<Register> *const SplitVirtRegs);
-	
-	bool spillInterferences(LiveInterval *const LI, MCRegister PhysReg,
-									SmallVectorImpl<Register> *const SplitVirtRegs);
     /**
      * @brief Build the whole graph.
      */
@@ -151,23 +710,27 @@ private:
      * @brief Try to materialize all the virtual registers.
      */
     void tryMaterializeAll();
-    void clear() { IntfRels.clear(); }
+    /**
+     * @brief Print the size and the memory use of the graph.
+     */
+    void printStats(raw_ostream &OS) const;
+    unsigned getNumCoalesced() const { return NumCoalescedInFunc; }
+    void clear() {
+      NumCoalescedInFunc = 0;
+      SplitRegs.clear();
+      IntfRels.clear();
+      VRegNodes.clear();
+      Matrices.clear();
+      UnitFiles.clear();
+      FixedRanges.clear();
+    }
   } G;
 
-  SmallPtrSet<MachineInstr *, 32> DeadRemats;
-  std::unique_ptr<Spiller> SpillerInst;
-
   void postOptimization() {
-    SpillerInst->postOptimization();
-    for (MachineInstr *const DeadInst : DeadRemats) {
-      LIS->RemoveMachineInstrFromMaps(*DeadInst);
-      DeadInst->eraseFromParent();
-    }
-    DeadRemats.clear();
+    RABase::postOptimization();
     G.clear();
   }
 
-  friend class AllocationHints;
   friend class IntfGraph;
 
   /// The following two methods are inherited from @c LiveRangeEdit::Delegate
@@ -183,7 +746,7 @@ private:
 		LI.clear();
 		return false;	
 	}
-	LRM->unassign(LI);
+	G.evict(LI);
 	G.erase(Reg);
     return true;
   }
@@ -196,7 +759,7 @@ private:
 	if (!VRM->hasPhys(Reg))
 		return;
 	LiveInterval &LI = LIS->getInterval(Reg);
-	LRM->unassign(LI);
+	G.evict(LI);
 	G.insert(Reg);
   }
 
@@ -207,39 +770,12 @@ public:
     return "Interference Graph Register Allocator";
   }
 
-  RAIntfGraph() : MachineFunctionPass(ID), G(this) {}
-
-  void getAnalysisUsage(AnalysisUsage &AU) const override {
-    MachineFunctionPass::getAnalysisUsage(AU);
-    AU.setPreservesCFG();
-#define REQUIRE_AND_PRESERVE_PASS(PassName)                                    \
-  AU.addRequired<PassName>();                                                  \
-  AU.addPreserved<PassName>()
-
-    REQUIRE_AND_PRESERVE_PASS(SlotIndexes);
-    REQUIRE_AND_PRESERVE_PASS(VirtRegMap);
-    REQUIRE_AND_PRESERVE_PASS(LiveIntervals);
-    REQUIRE_AND_PRESERVE_PASS(LiveRegMatrix);
-    REQUIRE_AND_PRESERVE_PASS(LiveStacks);
-    REQUIRE_AND_PRESERVE_PASS(AAResultsWrapperPass);
-    REQUIRE_AND_PRESERVE_PASS(MachineDominatorTree);
-    REQUIRE_AND_PRESERVE_PASS(MachineLoopInfo);
-    REQUIRE_AND_PRESERVE_PASS(MachineBlockFrequencyInfo);
-  }
-
-  MachineFunctionProperties getRequiredProperties() const override {
-    return MachineFunctionProperties().set(
-        MachineFunctionProperties::Property::NoPHIs);
-  }
-  MachineFunctionProperties getClearedProperties() const override {
-    return MachineFunctionProperties().set(
-        MachineFunctionProperties::Property::IsSSA);
-  }
+  RAIntfGraph() : RABase(ID), G(this) {}
 
   bool runOnMachineFunction(MachineFunction &MF) override;
 }; // class RAIntfGraph
 
-AllocationHints::AllocationHints(RAIntfGraph *const RA,
+AllocationHints::AllocationHints(RABase *const RA,
                                  const LiveInterval *const LI) {
   //const TargetRegisterClass *const RC = RA->MRI->getRegClass(LI->reg());
   const TargetRegisterClass *const RC = RA->MF->getRegInfo().getRegClass(LI->reg());
@@ -252,275 +788,1456 @@ AllocationHints::AllocationHints(RAIntfGraph *const RA,
   bool isHardHint =
 	RA->TRI->getRegAllocationHints(LI->reg(), Order, Hints, *RA->MF, RA->VRM, RA->LRM);
   if (!isHardHint) {
-	outs() << "noHardHint\n";
+	LLVM_DEBUG(dbgs() << "noHardHint\n");
 	for (const MCPhysReg &PhysReg : Order) {
 		Hints.push_back(PhysReg);
 	}
+	biasTowardsCopies(RA, LI);
+  }
+  LLVM_DEBUG({
+    dbgs() << "Hint Registers for Class " << RA->TRI->getRegClassName(RC)
+           << ": [";
+    for (const MCPhysReg &PhysReg : Hints) {
+      dbgs() << RA->TRI->getRegAsmName(PhysReg) << ", ";
+    }
+    dbgs() << "]\n";
+  });
+}
+
+void AllocationHints::biasTowardsCopies(RABase *const RA,
+                                        const LiveInterval *const LI) {
+  SmallVector<std::pair<double, MCPhysReg>, 4> Biases;
+  for (const MachineInstr &MI : RA->MRI->reg_nodbg_instructions(LI->reg())) {
+    if (!MI.isFullCopy()) {
+      continue;
+    }
+    Register Other = MI.getOperand(0).getReg() == LI->reg()
+                         ? MI.getOperand(1).getReg()
+                         : MI.getOperand(0).getReg();
+    if (Other.isVirtual()) {
+      Other = RA->VRM->hasPhys(Other) ? Register(RA->VRM->getPhys(Other))
+                                      : Register();
+    }
+    if (!Other.isPhysical() || !is_contained(Hints, Other)) {
+      continue;
+    }
+    const double Freq =
+        RA->MBFI->getBlockFreqRelativeToEntryBlock(MI.getParent());
+    auto BiasIt = find_if(Biases, [&](const auto &Bias) {
+      return Bias.second == Other;
+    });
+    if (BiasIt == Biases.end()) {
+      Biases.emplace_back(Freq, Other);
+    } else {
+      BiasIt->first += Freq;
+    }
   }
-  outs() << "Hint Registers for Class " << RA->TRI->getRegClassName(RC)
-         << ": [";
-  for (const MCPhysReg &PhysReg : Hints) {
-    outs() << RA->TRI->getRegAsmName(PhysReg) << ", ";
+  llvm::stable_sort(Biases, [](const auto &LHS, const auto &RHS) {
+    return LHS.first > RHS.first;
+  });
+  for (const auto &Bias : reverse(Biases)) {
+    auto HintIt = find(Hints, Bias.second);
+    std::rotate(Hints.begin(), HintIt, std::next(HintIt));
   }
-  outs() << "]\n";
 }
 
-bool RAIntfGraph::runOnMachineFunction(MachineFunction &MF) {
-  outs() << "************************************************\n"
-         << "* Machine Function\n"
-         << "************************************************\n";
-  SI = &getAnalysis<SlotIndexes>();
-  for (const MachineBasicBlock &MBB : MF) {
-    MBB.print(outs(), SI);
-    outs() << "\n";
+std::pair<unsigned, double> RABase::countMoves() const {
+  auto GetPhys = [&](const MachineOperand &MO) -> MCRegister {
+    if (MO.getReg().isPhysical()) {
+      return MO.getReg();
+    }
+    return VRM->hasPhys(MO.getReg()) ? VRM->getPhys(MO.getReg())
+                                     : MCRegister();
+  };
+  unsigned NumMoves = 0;
+  double Freq = 0;
+  for (const MachineBasicBlock &MBB : *MF) {
+    for (const MachineInstr &MI : MBB) {
+      if (!MI.isCopy()) {
+        continue;
+      }
+      const MachineOperand &DstMO = MI.getOperand(0), &SrcMO = MI.getOperand(1);
+      const MCRegister DstPhys = GetPhys(DstMO), SrcPhys = GetPhys(SrcMO);
+      if (DstPhys && DstPhys == SrcPhys &&
+          DstMO.getSubReg() == SrcMO.getSubReg()) {
+        continue;
+      }
+      ++NumMoves;
+      Freq += MBFI->getBlockFreqRelativeToEntryBlock(&MBB);
+    }
   }
-  outs() << "\n\n";
+  return {NumMoves, Freq};
+}
 
+void RABase::init(MachineFunction &MF) {
   this->MF = &MF;
 
+  SI = &getAnalysis<SlotIndexes>();
   VRM = &getAnalysis<VirtRegMap>();
   TRI = &VRM->getTargetRegInfo();
   MRI = &VRM->getRegInfo();
   MRI->freezeReservedRegs(MF);
   LIS = &getAnalysis<LiveIntervals>();
+  LSS = &getAnalysis<LiveStacks>();
   LRM = &getAnalysis<LiveRegMatrix>();
   RCI.runOnMachineFunction(MF);
   MLI = &getAnalysis<MachineLoopInfo>();
+  MBFI = &getAnalysis<MachineBlockFrequencyInfo>();
 
   SpillerInst.reset(createInlineSpiller(*this, MF, *VRM));
+  NumRematsInFunc = 0;
+}
 
-  G.build();
-  G.tryMaterializeAll();
-
-  postOptimization();
-  return true;
+void RABase::spill(LiveInterval &LI, LiveRangeEdit::Delegate &Delegate,
+                   SmallVectorImpl<Register> &NewRegs) {
+  LiveRangeEdit LRE(&LI, NewRegs, *MF, *LIS, VRM, &Delegate, &DeadRemats);
+  SpillerInst->spill(LRE);
+  NumRematsInFunc += countRemats(LRE.regs());
+  ++NumActualSpills;
 }
 
-void RAIntfGraph::IntfGraph::insert(const Register &Reg) {
-  /**
-   * @TODO(cscd70) Please implement this method.
-   */
-  auto *liveInterval = &(RA->LIS->getInterval(Reg));
-  IntfRels.insert({liveInterval, {}});
-  auto it = IntfRels.find(liveInterval);
-
-  // 1. Collect all VIRTUAL registers that interfere with 'Reg'.
-  for (unsigned virtRegIdx = 0; virtRegIdx < RA->MRI->getNumVirtRegs(); virtRegIdx++) {
-	Register curReg = Register::index2VirtReg(virtRegIdx);
-	if (curReg == Reg || RA->MRI->reg_nodbg_empty(curReg))
-	  continue;
-	auto *curLiveInterval = &(RA->LIS->getInterval(curReg));
-
-	if (curLiveInterval->overlaps(liveInterval)) {
-		outs() << "\tOverlapping {Reg=}" << *curLiveInterval << "\n";
-		// add curReg into the mapping of the input liveInterval
-		it->second.insert(curReg);
-		// add Reg into the mapping of curLiveInterval, if curLiveInterval already exists in IntfRels
-		auto it_curReg = IntfRels.find(curLiveInterval);
-		if (it_curReg != IntfRels.end())
-			it_curReg->second.insert(Reg);
-	}
+unsigned RABase::countRemats(ArrayRef<Register> NewRegs) const {
+  const TargetInstrInfo *const TII = MF->getSubtarget().getInstrInfo();
+  unsigned NumRematsOfSpill = 0;
+  for (const Register &NewReg : NewRegs) {
+    const bool Stored = any_of(
+        MRI->use_nodbg_instructions(NewReg), [&](const MachineInstr &MI) {
+          int FI;
+          return TII->isStoreToStackSlot(MI, FI);
+        });
+    for (const MachineInstr &MI : MRI->def_instructions(NewReg)) {
+      NumRematsOfSpill += !Stored && TII->isTriviallyReMaterializable(MI);
+    }
   }
-  updateWeight(*liveInterval);
-  outs() << "Inserting {Reg=}" << *liveInterval << "}\n";
-  // 2. Collect all PHYSICAL registers that interfere with 'Reg'.
-  // 3. Update the weights of Reg (and its interfering neighbors), using the
-  //    formula on "Lecture 6 Register Allocation Page 23".
-  // 4. Insert 'Reg' into the graph.
+  return NumRematsOfSpill;
 }
 
-void RAIntfGraph::IntfGraph::erase(const Register &Reg) {
-  /**
-   * @TODO(cscd70) Please implement this method.
-   */
-  // 1. ∀n ∈ neighbors(Reg), erase 'Reg' from n's interfering set and update its
-  //    weights accordingly.
-  // 2. Erase 'Reg' from the interference graph.
+void RABase::postOptimization() {
+  SpillerInst->postOptimization();
+  for (MachineInstr *const DeadInst : DeadRemats) {
+    LIS->RemoveMachineInstrFromMaps(*DeadInst);
+    DeadInst->eraseFromParent();
+  }
+  DeadRemats.clear();
+  colorSpillSlots();
+}
 
-  // IntfRels: std::multimap<LiveInterval*, std::unordered_set<Register>>
-  auto *liveInterval = &(RA->LIS->getInterval(Reg));
-  auto it = IntfRels.find(liveInterval);
-  if (it != IntfRels.end()) {
-	outs() << "Popping {Reg=" << *liveInterval << "}\n";
-	IntfRels.erase(liveInterval);
-	liveInterval->setWeight(-1);
-  }
-  for (auto &node : IntfRels) {
-	auto &regSet = node.second; 
-	if (regSet.count(Reg)) {
-	  regSet.erase(Reg);
-	  updateWeight(*(node.first));
-	}
+void RABase::reportSpillCode() {
+  const std::pair<unsigned, unsigned> SpillCode = countSpillCode();
+  NumSpillStores += SpillCode.first;
+  NumReloads += SpillCode.second;
+  NumRemats += NumRematsInFunc;
+  if (ReportAllocation) {
+    outs() << "Spill code of " << MF->getName() << ": " << SpillCode.first
+           << " stores, " << SpillCode.second << " reloads, "
+           << NumRematsInFunc << " rematerializations\n";
   }
 }
 
-inline void RAIntfGraph::IntfGraph::updateWeight(LiveInterval &node) {
-	int degree = IntfRels.find(&node)->second.size();
-	outs() << "\t" << degree << "\n";
-	if (degree)
-		node.setWeight(weightMap.at(node.reg()) / (double)degree);
-	// what if degree = 0? 
-}
-
-MCRegister RAIntfGraph::IntfGraph::selectOrSplit(LiveInterval *const LI,
-							 SmallVectorImpl<Register> *const SplitVirtRegs) {
-	AllocationHints AH(RA, LI);
-	SmallVector<MCRegister, 8> PhysRegSpillCandidates;
-	for (auto it = AH.begin(); it != AH.end(); it++) {
-		MCRegister PhysReg = *it;
-		// !!!
-		//if (assignedPhysReg.count(PhysReg))
-		//	continue;
-		switch (RA->LRM->checkInterference(*LI, PhysReg)) {
-		case LiveRegMatrix::IK_Free:
-			outs() << "Allocating physical register " << RA->TRI->getRegAsmName(PhysReg)
-				   << "\n";
-			return PhysReg;
-		case LiveRegMatrix::IK_VirtReg:
-			PhysRegSpillCandidates.push_back(PhysReg);
-			continue;
-		default:
-			continue;
-		}	
-	}
-	
-	for (MCRegister PhysReg : PhysRegSpillCandidates) {
-		outs() << "Hi\n";
-		if (!spillInterferences(LI, PhysReg, SplitVirtRegs))
-			continue;
-		return PhysReg;	
-	}
+bool RAIntfGraph::runOnMachineFunction(MachineFunction &MF) {
+  init(MF);
+  outs() << "************************************************\n"
+         << "* Machine Function\n"
+         << "************************************************\n";
+  for (const MachineBasicBlock &MBB : MF) {
+    MBB.print(outs(), SI);
+    outs() << "\n";
+  }
+  outs() << "\n\n";
 
-	LiveRangeEdit LRE(LI, *SplitVirtRegs, *RA->MF, *RA->LIS, RA->VRM, RA, &RA->DeadRemats);
-	RA->SpillerInst->spill(LRE);
-	outs() << "Hi\n";
-	return 0;	
-}
-
-bool RAIntfGraph::IntfGraph::spillInterferences(LiveInterval *const LI, MCRegister PhysReg,
-						 SmallVectorImpl<Register> *const SplitVirtRegs) {
-	SmallVector<LiveInterval*, 8> IntfLIs;
-	for (MCRegUnitIterator Units(PhysReg, RA->TRI); Units.isValid(); ++Units) {
-		LiveIntervalUnion::Query &Q = RA->LRM->query(*LI, *Units);
-		Q.collectInterferingVRegs();
-		for (LiveInterval *const IntfLI : Q.interferingVRegs()) {
-			if (!IntfLI->isSpillable() || IntfLI->weight() > LI->weight()) {
-				return false;
-			}
-			IntfLIs.push_back(IntfLI);
-		}
-	}
-	for (unsigned IntfIdx = 0; IntfIdx < IntfLIs.size(); IntfIdx++) {
-		LiveInterval *const LIToSpill = IntfLIs[IntfIdx];
-		if (!RA->VRM->hasPhys(LIToSpill->reg())) {
-			continue;
-		}
-		RA->LRM->unassign(*LIToSpill);
-		LiveRangeEdit LRE(LIToSpill, *SplitVirtRegs, *RA->MF, *RA->LIS, RA->VRM,
-						  RA, &RA->DeadRemats);
-		RA->SpillerInst->spill(LRE);
-	}
-	return true;
+  if (!Pool && NumColoringThreads != 1) {
+    Pool = std::make_unique<ThreadPool>(
+        hardware_concurrency(NumColoringThreads));
+  }
+
+  // Before the allocation, every copy is a potential move.
+  const std::pair<unsigned, double> MovesBefore = countMoves();
+  G.build();
+  G.tryMaterializeAll();
+  LLVM_DEBUG(G.printStats(dbgs()));
+  const std::pair<unsigned, double> MovesAfter = countMoves();
+  NumMovesLeft += MovesAfter.first;
+  if (ReportAllocation) {
+    outs() << "Moves of " << MF.getName() << ": " << G.getNumCoalesced()
+           << " coalesced, " << MovesBefore.first << " -> " << MovesAfter.first
+           << " static, " << format("%.2f", MovesBefore.second) << " -> "
+           << format("%.2f", MovesAfter.second)
+           << " dynamic (relative to the entry block)\n";
+  }
+
+  postOptimization();
+  reportSpillCode();
+  return true;
+}
+
+std::pair<unsigned, unsigned> RABase::countSpillCode() const {
+  const TargetInstrInfo *const TII = MF->getSubtarget().getInstrInfo();
+  const MachineFrameInfo &MFI = MF->getFrameInfo();
+  unsigned NumStores = 0, NumLoads = 0;
+  for (const MachineBasicBlock &MBB : *MF) {
+    for (const MachineInstr &MI : MBB) {
+      int FI;
+      if (TII->isStoreToStackSlot(MI, FI) && MFI.isSpillSlotObjectIndex(FI)) {
+        ++NumStores;
+      } else if (TII->isLoadFromStackSlot(MI, FI) &&
+                 MFI.isSpillSlotObjectIndex(FI)) {
+        ++NumLoads;
+      }
+    }
+  }
+  return {NumStores, NumLoads};
+}
+
+void RABase::colorSpillSlots() {
+  MachineFrameInfo &MFI = MF->getFrameInfo();
+  DenseMap<int, double> Freqs;
+  for (const MachineBasicBlock &MBB : *MF) {
+    const double Freq = MBFI->getBlockFreqRelativeToEntryBlock(&MBB);
+    for (const MachineInstr &MI : MBB) {
+      for (const MachineOperand &MO : MI.operands()) {
+        if (MO.isFI()) {
+          Freqs[MO.getIndex()] += Freq;
+        }
+      }
+    }
+  }
+  SmallVector<std::pair<double, int>, 16> Slots;
+  for (const auto &SlotIntervalPair : *LSS) {
+    const int FI = SlotIntervalPair.first;
+    if (MFI.isDeadObjectIndex(FI) || !MFI.isSpillSlotObjectIndex(FI) ||
+        MFI.getStackID(FI) != TargetStackID::Default) {
+      continue;
+    }
+    Slots.emplace_back(Freqs.lookup(FI), FI);
+  }
+  if (Slots.size() < 2) {
+    return;
+  }
+  // the most frequent first, ties broken by the index for determinism
+  llvm::sort(Slots, [](const auto &LHS, const auto &RHS) {
+    return LHS.first != RHS.first ? LHS.first > RHS.first
+                                  : LHS.second < RHS.second;
+  });
+
+  uint64_t BytesBefore = 0;
+  SmallVector<int, 8> Colors;
+  DenseMap<int, int> Remap;
+  for (const auto &FreqSlotPair : Slots) {
+    const int FI = FreqSlotPair.second;
+    LiveInterval &LI = LSS->getInterval(FI);
+    BytesBefore += MFI.getObjectSize(FI);
+    auto ColorIt = find_if(Colors, [&](const int Color) {
+      return !LSS->getInterval(Color).overlaps(LI);
+    });
+    if (ColorIt == Colors.end()) {
+      Colors.push_back(FI);
+      continue;
+    }
+    LiveInterval &ColorLI = LSS->getInterval(*ColorIt);
+    ColorLI.MergeSegmentsInAsValue(LI, ColorLI.getValNumInfo(0));
+    if (MFI.getObjectSize(FI) > MFI.getObjectSize(*ColorIt)) {
+      MFI.setObjectSize(*ColorIt, MFI.getObjectSize(FI));
+    }
+    MFI.setObjectAlignment(*ColorIt, std::max(MFI.getObjectAlign(*ColorIt),
+                                              MFI.getObjectAlign(FI)));
+    Remap[FI] = *ColorIt;
+  }
+  if (Remap.empty()) {
+    return;
+  }
+
+  for (MachineBasicBlock &MBB : *MF) {
+    for (MachineInstr &MI : MBB) {
+      for (MachineOperand &MO : MI.operands()) {
+        if (MO.isFI() && Remap.count(MO.getIndex())) {
+          MO.setIndex(Remap[MO.getIndex()]);
+        }
+      }
+      for (MachineMemOperand *const MMO : MI.memoperands()) {
+        const FixedStackPseudoSourceValue *const FSV =
+            dyn_cast_or_null<FixedStackPseudoSourceValue>(
+                MMO->getPseudoValue());
+        if (FSV && Remap.count(FSV->getFrameIndex())) {
+          MMO->setValue(MF->getPSVManager().getFixedStack(
+              Remap[FSV->getFrameIndex()]));
+        }
+      }
+    }
+  }
+  for (const auto &SlotColorPair : Remap) {
+    MFI.RemoveStackObject(SlotColorPair.first);
+  }
+  uint64_t BytesAfter = 0;
+  for (const int Color : Colors) {
+    BytesAfter += MFI.getObjectSize(Color);
+  }
+  NumSlotsMerged += Remap.size();
+  NumSlotBytesSaved += BytesBefore - BytesAfter;
+  if (ReportAllocation) {
+    outs() << "Spill slots of " << MF->getName() << ": " << Slots.size()
+           << " -> " << Colors.size() << ", " << BytesBefore - BytesAfter
+           << " bytes saved\n";
+  }
+}
+
+unsigned RAIntfGraph::IntfGraph::getRegFile(const TargetRegisterClass &RC) {
+  for (const MCPhysReg PhysReg : RC) {
+    for (MCRegUnitIterator Units(PhysReg, RA->TRI); Units.isValid(); ++Units) {
+      auto UnitFileIt = UnitFiles.find(*Units);
+      if (UnitFileIt != UnitFiles.end()) {
+        return UnitFileIt->second;
+      }
+    }
+  }
+  SmallSetVector<unsigned, 16> Units;
+  for (const MCPhysReg PhysReg : RC) {
+    for (MCRegUnitIterator UnitIt(PhysReg, RA->TRI); UnitIt.isValid();
+         ++UnitIt) {
+      Units.insert(*UnitIt);
+    }
+  }
+  return addRegFile(Units);
+}
+
+template <typename UnitRangeT>
+unsigned RAIntfGraph::IntfGraph::addRegFile(UnitRangeT Units) {
+  const unsigned File = Matrices.size();
+  Matrices.emplace_back();
+  IntfRels.emplace_back();
+  FixedRanges.emplace_back();
+  for (const unsigned Unit : Units) {
+    UnitFiles[Unit] = File;
+    const LiveRange &LR = RA->LIS->getRegUnit(Unit);
+    if (!LR.empty()) {
+      FixedRanges[File].emplace_back(Unit, &LR);
+    }
+  }
+  return File;
+}
+
+void RAIntfGraph::IntfGraph::computeRegFiles() {
+  // Union the register classes through their register units, before any
+  // node is numbered. The classes of the split registers are subclasses of
+  // these, hence they fall into the existing files later on.
+  SmallPtrSet<const TargetRegisterClass *, 16> RCs;
+  for (unsigned VirtRegIdx = 0; VirtRegIdx < RA->MRI->getNumVirtRegs();
+       ++VirtRegIdx) {
+    const Register VirtReg = Register::index2VirtReg(VirtRegIdx);
+    if (!RA->MRI->reg_nodbg_empty(VirtReg)) {
+      RCs.insert(RA->MRI->getRegClass(VirtReg));
+    }
+  }
+  EquivalenceClasses<unsigned> UnitClasses;
+  for (const TargetRegisterClass *const RC : RCs) {
+    Optional<unsigned> FirstUnit;
+    for (const MCPhysReg PhysReg : *RC) {
+      for (MCRegUnitIterator Units(PhysReg, RA->TRI); Units.isValid();
+           ++Units) {
+        UnitClasses.insert(*Units);
+        if (FirstUnit) {
+          UnitClasses.unionSets(*FirstUnit, *Units);
+        } else {
+          FirstUnit = *Units;
+        }
+      }
+    }
+  }
+  for (auto ClassIt = UnitClasses.begin(); ClassIt != UnitClasses.end();
+       ++ClassIt) {
+    if (!ClassIt->isLeader()) {
+      continue;
+    }
+    addRegFile(make_range(UnitClasses.member_begin(ClassIt),
+                          UnitClasses.member_end()));
+  }
+}
+
+void RAIntfGraph::IntfGraph::addEdge(const Register &A, const Register &B) {
+  Node &NodeA = getNode(A), &NodeB = getNode(B);
+  if (NodeA.File != NodeB.File ||
+      !Matrices[NodeA.File].set(NodeA.Num, NodeB.Num)) {
+    return;
+  }
+  NodeA.Neighbors.push_back(B);
+  NodeB.Neighbors.push_back(A);
+  if (NodeA.InGraph && NodeB.InGraph) {
+    ++NodeA.Degree;
+    ++NodeB.Degree;
+  }
+}
+
+void RAIntfGraph::IntfGraph::addFixedEdge(const Register &Reg,
+                                          const unsigned Unit) {
+  SmallVectorImpl<unsigned> &FixedUnits = getNode(Reg).FixedUnits;
+  if (!is_contained(FixedUnits, Unit)) {
+    FixedUnits.push_back(Unit);
+  }
+}
+
+void RAIntfGraph::IntfGraph::removeEdges(const Register &Reg) {
+  Node &RegNode = getNode(Reg);
+  RegNode.FixedUnits.clear();
+  for (const Register &Neighbor : RegNode.Neighbors) {
+    Node &NeighborNode = getNode(Neighbor);
+    NeighborNode.Neighbors.erase(std::remove(NeighborNode.Neighbors.begin(),
+                                             NeighborNode.Neighbors.end(),
+                                             Reg),
+                                 NeighborNode.Neighbors.end());
+    Matrices[RegNode.File].reset(RegNode.Num, NeighborNode.Num);
+    if (RegNode.InGraph && NeighborNode.InGraph) {
+      --NeighborNode.Degree;
+    }
+  }
+  RegNode.Neighbors.clear();
+  RegNode.Degree = 0;
+}
+
+bool RAIntfGraph::IntfGraph::interferes(const Register &A,
+                                        const Register &B) {
+  const Node &NodeA = getNode(A), &NodeB = getNode(B);
+  return NodeA.File == NodeB.File &&
+         Matrices[NodeA.File].test(NodeA.Num, NodeB.Num);
+}
+
+bool RAIntfGraph::IntfGraph::canCoalesce(const Register &Dst,
+                                         const Register &Src,
+                                         const TargetRegisterClass &RC) {
+  const unsigned K = RA->RCI.getNumAllocatableRegs(&RC);
+  // George: every neighbor of Src already interferes with Dst, or is of
+  // insignificant degree.
+  if (all_of(getNode(Src).Neighbors, [&](const Register &Neighbor) {
+        return !getNode(Neighbor).InGraph || getNode(Neighbor).Degree < K ||
+               interferes(Neighbor, Dst);
+      })) {
+    return true;
+  }
+  // Briggs: the merged node has fewer than K neighbors of significant degree,
+  // where the common neighbors lose one edge in the merge.
+  SmallSet<unsigned, 16> Visited;
+  unsigned NumSignificant = 0;
+  for (const Register &Reg : {Dst, Src}) {
+    for (const Register &Neighbor : getNode(Reg).Neighbors) {
+      const Node &NeighborNode = getNode(Neighbor);
+      if (!NeighborNode.InGraph || !Visited.insert(Neighbor.id()).second) {
+        continue;
+      }
+      const bool Common =
+          interferes(Neighbor, Dst) && interferes(Neighbor, Src);
+      NumSignificant += NeighborNode.Degree - Common >= K;
+    }
+  }
+  return NumSignificant < K;
+}
+
+void RAIntfGraph::IntfGraph::merge(const Register &Dst, const Register &Src,
+                                   const TargetRegisterClass &RC,
+                                   SmallPtrSetImpl<MachineInstr *> &Erased) {
+  const SmallVector<Register, 8> SrcNeighbors = getNode(Src).Neighbors;
+  getQueue(Src).erase(Src);
+  removeEdges(Src);
+  getNode(Src).InGraph = false;
+  weightMap.erase(Src);
+
+  RA->LIS->removeInterval(Src);
+  RA->LIS->removeInterval(Dst);
+  RA->MRI->setRegClass(Dst, &RC);
+  RA->MRI->replaceRegWith(Src, Dst);
+  // an identity copy is visited once per operand
+  SmallVector<MachineInstr *, 4> IdentityCopies;
+  for (MachineInstr &MI : RA->MRI->reg_instructions(Dst)) {
+    if (MI.isCopy() && MI.getOperand(0).getReg() == MI.getOperand(1).getReg() &&
+        MI.getOperand(0).getSubReg() == MI.getOperand(1).getSubReg() &&
+        Erased.insert(&MI).second) {
+      IdentityCopies.push_back(&MI);
+    }
+  }
+  for (MachineInstr *const MI : IdentityCopies) {
+    RA->LIS->RemoveMachineInstrFromMaps(*MI);
+    MI->eraseFromParent();
+  }
+  RA->LIS->createAndComputeVirtRegInterval(Dst);
+
+  // The merged interval is the union of the two, save the deleted copies,
+  // hence its neighbors are those of either.
+  for (const Register &Neighbor : SrcNeighbors) {
+    addEdge(Dst, Neighbor);
+  }
+  weightMap.erase(Dst);
+  initializeWeight(Dst);
+  updateWeight(RA->LIS->getInterval(Dst));
+  for (const Register &Neighbor : getNode(Dst).Neighbors) {
+    if (getNode(Neighbor).InGraph) {
+      updateWeight(RA->LIS->getInterval(Neighbor));
+    }
+  }
+}
+
+void RAIntfGraph::IntfGraph::coalesce() {
+  std::vector<std::pair<double, MachineInstr *>> Copies;
+  for (MachineBasicBlock &MBB : *RA->MF) {
+    const double Freq = RA->MBFI->getBlockFreqRelativeToEntryBlock(&MBB);
+    for (MachineInstr &MI : MBB) {
+      if (MI.isFullCopy() && MI.getOperand(0).getReg().isVirtual() &&
+          MI.getOperand(1).getReg().isVirtual()) {
+        Copies.emplace_back(Freq, &MI);
+      }
+    }
+  }
+  llvm::stable_sort(Copies, [](const auto &LHS, const auto &RHS) {
+    return LHS.first > RHS.first;
+  });
+
+  SmallPtrSet<MachineInstr *, 16> Erased;
+  for (const auto &FreqCopyPair : Copies) {
+    MachineInstr *const MI = FreqCopyPair.second;
+    if (Erased.count(MI)) {
+      continue;
+    }
+    const Register Dst = MI->getOperand(0).getReg(),
+                   Src = MI->getOperand(1).getReg();
+    if (!getNode(Dst).InGraph || !getNode(Src).InGraph ||
+        interferes(Dst, Src) || getNode(Dst).File != getNode(Src).File) {
+      continue;
+    }
+    // The merged register must fit both classes, and the sub-register
+    // indices used with either must remain valid.
+    const TargetRegisterClass *const DstRC = RA->MRI->getRegClass(Dst),
+                                *const SrcRC = RA->MRI->getRegClass(Src);
+    const TargetRegisterClass *const RC =
+        RA->TRI->getCommonSubClass(DstRC, SrcRC);
+    if (!RC || (RC != DstRC && RC != SrcRC) || !canCoalesce(Dst, Src, *RC)) {
+      continue;
+    }
+    LLVM_DEBUG(dbgs() << "Coalescing " << printReg(Src, RA->TRI) << " into "
+                      << printReg(Dst, RA->TRI) << "\n");
+    merge(Dst, Src, *RC, Erased);
+    ++NumCoalescedInFunc;
+    ++NumCoalesced;
+  }
+}
+
+template <typename TaskT>
+void RAIntfGraph::IntfGraph::forEachFile(ArrayRef<unsigned> Files,
+                                         TaskT Task) {
+  growNodes();
+  if (!RA->Pool || Files.size() < 2) {
+    for (const unsigned File : Files) {
+      Task(File);
+    }
+    return;
+  }
+  for (const unsigned File : Files) {
+    RA->Pool->async(Task, File);
+  }
+  RA->Pool->wait();
+}
+
+void RAIntfGraph::IntfGraph::insert(ArrayRef<Register> Regs) {
+  // The new live intervals of each file come first, followed by the nodes of
+  // the file whose range intersects theirs, as only those can overlap them.
+  std::vector<std::vector<LiveInterval *>> FileLIs(Matrices.size());
+  std::vector<std::pair<SlotIndex, SlotIndex>> FileRanges(Matrices.size());
+  std::vector<LiveInterval *> NewLIs;
+  growNodes();
+  for (const Register &Reg : Regs) {
+    LiveInterval &LI = RA->LIS->getInterval(Reg);
+    if (LI.empty() || getNode(Reg).InGraph) {
+      continue;
+    }
+    if (!weightMap.count(Reg)) {
+      initializeWeight(Reg);
+    }
+    Node &RegNode = getNode(Reg);
+    if (RegNode.File == ~0U) {
+      RegNode.File = getRegFile(*RA->MRI->getRegClass(Reg));
+      RegNode.Num = Matrices[RegNode.File].addNode();
+      FileLIs.resize(Matrices.size());
+      FileRanges.resize(Matrices.size());
+    } else {
+      // the live interval has changed since its edges were computed
+      removeEdges(Reg);
+    }
+    RegNode.InGraph = true;
+    RegNode.Color = 0;
+    NewLIs.push_back(&LI);
+    FileLIs[RegNode.File].push_back(&LI);
+    SlotIndex &Begin = FileRanges[RegNode.File].first,
+              &End = FileRanges[RegNode.File].second;
+    Begin =
+        Begin.isValid() ? std::min(Begin, LI.beginIndex()) : LI.beginIndex();
+    End = End.isValid() ? std::max(End, LI.endIndex()) : LI.endIndex();
+  }
+  if (NewLIs.empty()) {
+    return;
+  }
+  SmallVector<unsigned, 4> Files;
+  for (unsigned File = 0; File < FileLIs.size(); ++File) {
+    if (!FileLIs[File].empty()) {
+      Files.push_back(File);
+    }
+  }
+
+  forEachFile(Files, [&](const unsigned File) {
+    std::vector<LiveInterval *> &LIs = FileLIs[File];
+    const size_t NumNew = LIs.size();
+    // The nodes still to be colored, and those colored in earlier rounds,
+    // which keep their registers, are the old ones.
+    for (unsigned VirtRegIdx = 0; VirtRegIdx < VRegNodes.size();
+         ++VirtRegIdx) {
+      const Register Reg = Register::index2VirtReg(VirtRegIdx);
+      const Node &RegNode = VRegNodes[VirtRegIdx];
+      if (RegNode.File != File ||
+          !(IntfRels[File].contains(Reg) || RegNode.Color)) {
+        continue;
+      }
+      // e.g., a colored one left empty by the spiller, before it is erased
+      LiveInterval *const LI = &RA->LIS->getInterval(Reg);
+      if (!LI->empty() && LI->beginIndex() < FileRanges[File].second &&
+          FileRanges[File].first < LI->endIndex()) {
+        LIs.push_back(LI);
+      }
+    }
+    // the precolored nodes come last
+    std::vector<const LiveRange *> LRs(LIs.begin(), LIs.end());
+    for (const auto &UnitRangePair : FixedRanges[File]) {
+      LRs.push_back(UnitRangePair.second);
+    }
+    forEachOverlap(LRs, NumNew, [&](size_t LHSIdx, size_t RHSIdx) {
+      if (LHSIdx > RHSIdx) {
+        std::swap(LHSIdx, RHSIdx);
+      }
+      if (RHSIdx < LIs.size()) {
+        addEdge(LIs[LHSIdx]->reg(), LIs[RHSIdx]->reg());
+      } else {
+        addFixedEdge(LIs[LHSIdx]->reg(),
+                     FixedRanges[File][RHSIdx - LIs.size()].first);
+      }
+    });
+    for (LiveInterval *const LI : LIs) {
+      if (getNode(LI->reg()).InGraph) {
+        updateWeight(*LI);
+      }
+    }
+  });
+  for (LiveInterval *const LI : NewLIs) {
+    computeNumColors(*LI);
+    outs() << "Inserting {Reg=" << *LI << "}\n";
+  }
+}
+
+void RAIntfGraph::IntfGraph::erase(const Register &Reg, raw_ostream &OS) {
+  /**
+   * @TODO(cscd70) Please implement this method.
+   */
+  // 1. ∀n ∈ neighbors(Reg), erase 'Reg' from n's interfering set and update its
+  //    weights accordingly.
+  // 2. Erase 'Reg' from the interference graph.
+
+  if (!getNode(Reg).InGraph)
+	return;
+  OS << "Popping {Reg=" << RA->LIS->getInterval(Reg) << "}\n";
+  getQueue(Reg).erase(Reg);
+  // The edges stay in the graph, but no longer count towards the degrees.
+  getNode(Reg).InGraph = false;
+  for (const Register &neighborReg : getNode(Reg).Neighbors) {
+	Node &neighborNode = getNode(neighborReg);
+	if (!neighborNode.InGraph)
+	  continue;
+	--neighborNode.Degree;
+	updateWeight(RA->LIS->getInterval(neighborReg));
+  }
+}
+
+inline void RAIntfGraph::IntfGraph::updateWeight(LiveInterval &node) {
+	int degree = getNode(node.reg()).Degree;
+	float cost = weightMap.at(node.reg());
+	// a node without neighbors keeps its whole cost
+	node.setWeight(cost / (double)std::max(degree, 1));
+	// Reorder the node under its new priority, the interferences that
+	// spilling it would remove per unit of cost.
+	getQueue(node.reg())
+	    .update(node.reg(), cost > 0 ? degree / cost : huge_valf);
 }
 
 void RAIntfGraph::IntfGraph::build() {
   /**
    * @TODO(cscd70) Please implement this method.
    */
+  // All the registers are inserted at once, so that a single sweep finds the
+  // interferences among them.
+  computeRegFiles();
+  SmallVector<Register, 64> virtRegs;
   for (unsigned virtRegIdx = 0; virtRegIdx < RA->MRI->getNumVirtRegs();
 		virtRegIdx++) {
 	Register virtReg = Register::index2VirtReg(virtRegIdx);
 	if (RA->MRI->reg_nodbg_empty(virtReg))	continue;
 	initializeWeight(virtReg);
-	insert(virtReg);	
+	virtRegs.push_back(virtReg);
+  }
+  insert(virtRegs);
+  if (EnableCoalescing) {
+    coalesce();
   }
 }
 
 void RAIntfGraph::IntfGraph::initializeWeight(const Register &Reg) {
+	LiveInterval &LI = RA->LIS->getInterval(Reg);
+	// Like CalcSpillWeights, the intervals that are already as short as the
+	// instructions that use them cannot be spilled any further, and neither
+	// can the reloads and stores created by spilling, as spilling them again
+	// would only recreate them.
+	const Register Original = RA->VRM->getOriginal(Reg);
+	if ((LI.isZeroLength(RA->LIS->getSlotIndexes()) &&
+	     !LI.isLiveAtIndexes(RA->LIS->getRegMaskSlots())) ||
+	    (Original != Reg &&
+	     RA->VRM->getStackSlot(Original) != VirtRegMap::NO_STACK_SLOT)) {
+		weightMap.emplace(Reg, huge_valf);
+		return;
+	}
+
+	// the frequency of the reads and writes, each instruction counted once
 	float weight = 0;
-	for (auto it = RA->MRI->reg_instr_begin(Reg);
-			it != RA->MRI->reg_instr_end(); it++) {
-		MachineInstr *mcInst = &(*it);
-		unsigned loopDepth = RA->MLI->getLoopDepth(mcInst->getParent());
-		auto rw = mcInst->readsWritesVirtualRegister(Reg);
-		weight += (rw.first + rw.second) * std::pow(10, loopDepth);	
+	unsigned numInstrs = 0;
+	SmallPtrSet<const MachineInstr *, 16> visited;
+	for (const MachineInstr &mcInst : RA->MRI->reg_nodbg_instructions(Reg)) {
+		if (!visited.insert(&mcInst).second)
+			continue;
+		auto rw = mcInst.readsWritesVirtualRegister(Reg);
+		weight += LiveIntervals::getSpillWeight(rw.second, rw.first, RA->MBFI,
+		                                        mcInst);
+		++numInstrs;
 	}
-	weightMap.emplace(Reg, weight); 
+	// A rematerializable value is recomputed rather than reloaded.
+	if (VirtRegAuxInfo::isRematerializable(
+	        LI, *RA->LIS, *RA->VRM, *RA->MF->getSubtarget().getInstrInfo()))
+		weight *= 0.5F;
+	// Spilling a long interval frees a register over more code for the same
+	// number of reloads.
+	weightMap.emplace(Reg,
+	                  normalizeSpillWeight(weight, LI.getSize(), numInstrs));
+}
+
+
+void RAIntfGraph::IntfGraph::printStats(raw_ostream &OS) const {
+  OS << "Interference graph of " << RA->MF->getName() << ":\n";
+  std::vector<size_t> AdjSizes(Matrices.size()),
+      NumFixedEdges(Matrices.size());
+  for (const Node &N : VRegNodes) {
+    if (N.File != ~0U) {
+      AdjSizes[N.File] += capacity_in_bytes(N.Neighbors);
+      NumFixedEdges[N.File] += N.FixedUnits.size();
+    }
+  }
+  size_t TotalSize = 0;
+  for (unsigned File = 0; File < Matrices.size(); ++File) {
+    const IntfMatrix &Matrix = Matrices[File];
+    if (Matrix.getNumNodes() == 0) {
+      continue;
+    }
+    OS << "  Register file " << File << ": " << Matrix.getNumNodes()
+       << " nodes, " << Matrix.getNumEdges() << " edges, "
+       << FixedRanges[File].size() << " precolored units with "
+       << NumFixedEdges[File] << " edges, "
+       << Matrix.getMemorySize() << " bytes of matrix, " << AdjSizes[File]
+       << " bytes of adjacency vectors\n";
+    TotalSize += Matrix.getMemorySize() + AdjSizes[File];
+  }
+  OS << "  Total: " << TotalSize << " bytes\n";
+}
+
+void RAIntfGraph::IntfGraph::computeNumColors(LiveInterval &LI) {
+  BitVector Blocked(RA->TRI->getNumRegUnits());
+  collectBlockedUnits(LI.reg(), Blocked);
+  unsigned &NumColors = getNode(LI.reg()).NumColors;
+  NumColors = 0;
+  for (const MCPhysReg PhysReg :
+       RA->RCI.getOrder(RA->MRI->getRegClass(LI.reg()))) {
+    NumColors += !isBlocked(PhysReg, Blocked) &&
+                 !RA->LRM->checkRegMaskInterference(LI, PhysReg);
+  }
+}
+
+void RAIntfGraph::IntfGraph::collectBlockedUnits(const Register &Reg,
+                                                 BitVector &Blocked) {
+  const Node &RegNode = getNode(Reg);
+  for (const unsigned Unit : RegNode.FixedUnits) {
+    Blocked.set(Unit);
+  }
+  for (const Register &Neighbor : RegNode.Neighbors) {
+    if (const MCPhysReg NeighborColor = getNode(Neighbor).Color) {
+      for (MCRegUnitIterator Units(NeighborColor, RA->TRI); Units.isValid();
+           ++Units) {
+        Blocked.set(*Units);
+      }
+    }
+  }
+}
+
+bool RAIntfGraph::IntfGraph::isBlocked(const MCPhysReg PhysReg,
+                                       const BitVector &Blocked) const {
+  for (MCRegUnitIterator Units(PhysReg, RA->TRI); Units.isValid(); ++Units) {
+    if (Blocked.test(*Units)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<Register> RAIntfGraph::IntfGraph::simplify(const unsigned File,
+                                                       raw_ostream &OS) {
+  RegPriorityQueue &Queue = IntfRels[File];
+  std::vector<Register> Stack;
+  SmallVector<Register, 16> LowDegree;
+  for (const Register Reg : Queue.regs()) {
+    if (getNode(Reg).Degree < getNumColors(Reg)) {
+      LowDegree.push_back(Reg);
+    }
+  }
+  while (!Queue.empty()) {
+    Register Reg;
+    while (!LowDegree.empty() && !Reg) {
+      // A node may be queued again after its removal, when the degree of a
+      // neighbor is updated.
+      if (Queue.contains(LowDegree.back())) {
+        Reg = LowDegree.back();
+      }
+      LowDegree.pop_back();
+    }
+    if (!Reg) {
+      Reg = Queue.top();
+    }
+    Stack.push_back(Reg);
+    erase(Reg, OS);
+    for (const Register &Neighbor : getNode(Reg).Neighbors) {
+      // only the neighbors that just became insignificant
+      if (getNode(Neighbor).InGraph &&
+          getNode(Neighbor).Degree + 1 == getNumColors(Neighbor)) {
+        LowDegree.push_back(Neighbor);
+      }
+    }
+  }
+  return Stack;
 }
 
+void RAIntfGraph::IntfGraph::prepareSelect(LiveInterval &LI) {
+  Node &RegNode = getNode(LI.reg());
+  RegNode.Color = 0;
+  RegNode.Candidates.clear();
+  AllocationHints AH(RA, &LI);
+  // The precolored neighbors are left to the selection, as are the colored
+  // ones.
+  for (const MCPhysReg PhysReg : AH) {
+    if (!RA->LRM->checkRegMaskInterference(LI, PhysReg)) {
+      RegNode.Candidates.push_back(PhysReg);
+    }
+  }
+  // The partners have no color yet, hence the bias towards them is only
+  // applied in the selection.
+  RegNode.CopyPartners.clear();
+  for (const MachineInstr &MI : RA->MRI->reg_nodbg_instructions(LI.reg())) {
+    if (!MI.isFullCopy()) {
+      continue;
+    }
+    const Register Other = MI.getOperand(0).getReg() == LI.reg()
+                               ? MI.getOperand(1).getReg()
+                               : MI.getOperand(0).getReg();
+    if (!Other.isVirtual() || Other == LI.reg() || !getNode(Other).InGraph ||
+        getNode(Other).File != RegNode.File) {
+      continue;
+    }
+    const double Freq =
+        RA->MBFI->getBlockFreqRelativeToEntryBlock(MI.getParent());
+    auto PartnerIt = find_if(RegNode.CopyPartners, [&](const auto &Partner) {
+      return Partner.second == Other;
+    });
+    if (PartnerIt == RegNode.CopyPartners.end()) {
+      RegNode.CopyPartners.emplace_back(Freq, Other);
+    } else {
+      PartnerIt->first += Freq;
+    }
+  }
+  llvm::stable_sort(RegNode.CopyPartners, [](const auto &LHS, const auto &RHS) {
+    return LHS.first > RHS.first;
+  });
+}
+
+MCPhysReg RAIntfGraph::IntfGraph::selectColor(const Register &Reg,
+                                              BitVector &Blocked,
+                                              raw_ostream &OS) {
+  Node &RegNode = getNode(Reg);
+  // The neighbors are exactly the live ranges that overlap Reg in
+  // LiveRegMatrix, hence the units they take are those in use.
+  Blocked.reset();
+  collectBlockedUnits(Reg, Blocked);
+  auto IsFree = [&](const MCPhysReg PhysReg) {
+    return PhysReg && !isBlocked(PhysReg, Blocked) &&
+           is_contained(RegNode.Candidates, PhysReg);
+  };
+  MCPhysReg Color = 0;
+  for (const auto &Partner : RegNode.CopyPartners) {
+    if (IsFree(getNode(Partner.second).Color)) {
+      Color = getNode(Partner.second).Color;
+      break;
+    }
+  }
+  if (!Color) {
+    auto CandidateIt = find_if(RegNode.Candidates, IsFree);
+    Color = CandidateIt != RegNode.Candidates.end() ? *CandidateIt : 0;
+  }
+  if (Color) {
+    OS << "Allocating physical register " << RA->TRI->getRegAsmName(Color)
+       << "\n";
+  }
+  RegNode.Color = Color;
+  return Color;
+}
+
+std::vector<Register>
+RAIntfGraph::IntfGraph::colorFile(const unsigned File, raw_ostream &OS) {
+  const std::vector<Register> Stack = simplify(File, OS);
+  BitVector Blocked(RA->TRI->getNumRegUnits());
+  // the neighbors removed before a node are colored after it
+  std::vector<Register> Selected(Stack.rbegin(), Stack.rend());
+  for (const Register &Reg : Selected) {
+    selectColor(Reg, Blocked, OS);
+  }
+  return Selected;
+}
+
+void RAIntfGraph::IntfGraph::collectSpills(LiveInterval *const LI,
+                                           SetVector<LiveInterval *> &Spills) {
+  if (LI->isSpillable()) {
+    Spills.insert(LI);
+    return;
+  }
+  AllocationHints AH(RA, LI);
+  for (const MCPhysReg PhysReg : AH) {
+    if (RA->LRM->checkInterference(*LI, PhysReg) !=
+        LiveRegMatrix::IK_VirtReg) {
+      continue;
+    }
+    SmallVector<LiveInterval *, 4> IntfLIs;
+    for (MCRegUnitIterator Units(PhysReg, RA->TRI); Units.isValid(); ++Units) {
+      LiveIntervalUnion::Query &Q = RA->LRM->query(*LI, *Units);
+      Q.collectInterferingVRegs();
+      for (LiveInterval *const IntfLI : Q.interferingVRegs()) {
+        IntfLIs.push_back(IntfLI);
+      }
+    }
+    if (all_of(IntfLIs, [](LiveInterval *const IntfLI) {
+          return IntfLI->isSpillable();
+        })) {
+      Spills.insert(IntfLIs.begin(), IntfLIs.end());
+      return;
+    }
+  }
+  report_fatal_error("ran out of registers during register allocation");
+}
+
+template <typename InRegionT>
+std::pair<Register, Register> RAIntfGraph::IntfGraph::splitRegion(
+    const Register &Reg, InRegionT InRegion,
+    ArrayRef<InsertPoint_t> EntryPoints, ArrayRef<InsertPoint_t> ExitPoints) {
+  const TargetInstrInfo *const TII = RA->MF->getSubtarget().getInstrInfo();
+  const Register Original = RA->VRM->getOriginal(Reg);
+  const Register Remainder =
+      Reg == Original ? RA->MRI->cloneVirtualRegister(Reg) : Reg;
+  const Register NewReg = RA->MRI->cloneVirtualRegister(Reg);
+  RA->VRM->grow();
+  for (MachineOperand &MO :
+       make_early_inc_range(RA->MRI->reg_operands(Reg))) {
+    MO.setReg(InRegion(*MO.getParent()->getParent()) ? NewReg : Remainder);
+  }
+  auto InsertCopy = [&](const InsertPoint_t &InsertPt, const Register &Dst,
+                        const Register &Src) {
+    MachineInstr *const Copy =
+        BuildMI(*InsertPt.first, InsertPt.second, DebugLoc(),
+                TII->get(TargetOpcode::COPY), Dst)
+            .addReg(Src);
+    RA->LIS->InsertMachineInstrInMaps(*Copy);
+  };
+  for (const InsertPoint_t &InsertPt : EntryPoints) {
+    InsertCopy(InsertPt, NewReg, Remainder);
+  }
+  for (const InsertPoint_t &InsertPt : ExitPoints) {
+    InsertCopy(InsertPt, Remainder, NewReg);
+  }
+
+  if (Reg == Original) {
+    // no longer used, but kept for the rematerialization
+    removeEdges(Reg);
+  } else {
+    RA->LIS->removeInterval(Reg);
+  }
+  weightMap.erase(Reg);
+  for (const Register &SplitReg : {Remainder, NewReg}) {
+    RA->VRM->setIsSplitFromReg(SplitReg, Original);
+    // e.g., the remainder before and after a loop are unrelated values
+    SmallVector<LiveInterval *, 2> Components;
+    RA->LIS->splitSeparateComponents(
+        RA->LIS->createAndComputeVirtRegInterval(SplitReg), Components);
+    RA->VRM->grow();
+    SplitRegs.insert(SplitReg);
+    for (const LiveInterval *const Component : Components) {
+      RA->VRM->setIsSplitFromReg(Component->reg(), Original);
+      SplitRegs.insert(Component->reg());
+    }
+  }
+  return {NewReg, Remainder};
+}
+
+bool RAIntfGraph::IntfGraph::isColorableIn(
+    const Register &Reg, ArrayRef<MachineBasicBlock *> Region) {
+  const SmallPtrSet<MachineBasicBlock *, 16> RegionSet(Region.begin(),
+                                                       Region.end());
+  unsigned NumUsedNeighbors = 0;
+  for (const Register &Neighbor : getNode(Reg).Neighbors) {
+    NumUsedNeighbors += any_of(
+        RA->MRI->reg_nodbg_instructions(Neighbor),
+        [&](MachineInstr &MI) { return RegionSet.count(MI.getParent()); });
+  }
+  return NumUsedNeighbors < getNumColors(Reg);
+}
+
+bool RAIntfGraph::IntfGraph::splitAroundLoop(LiveInterval &LI,
+                                             MachineLoop &L) {
+  // Without a register for the loop part, the split would only add copies
+  // to the spill code.
+  MachineBasicBlock *const Preheader = L.getLoopPreheader();
+  if (!Preheader || !isColorableIn(LI.reg(), L.getBlocks())) {
+    return false;
+  }
+  SmallVector<MachineBasicBlock *, 4> ExitBlocks;
+  L.getUniqueExitBlocks(ExitBlocks);
+  const bool LiveIn = RA->LIS->isLiveInToMBB(LI, L.getHeader());
+  SmallVector<InsertPoint_t, 4> ExitPoints;
+  for (MachineBasicBlock *const ExitBB : ExitBlocks) {
+    if (!RA->LIS->isLiveInToMBB(LI, ExitBB)) {
+      continue;
+    }
+    // the copy back must only run on the way out of the loop
+    if (ExitBB->isEHPad() ||
+        any_of(ExitBB->predecessors(), [&](MachineBasicBlock *const Pred) {
+          return !L.contains(Pred);
+        })) {
+      return false;
+    }
+    ExitPoints.emplace_back(ExitBB,
+                            ExitBB->SkipPHIsLabelsAndDebug(ExitBB->begin()));
+  }
+  if (!LiveIn && ExitPoints.empty()) {
+    return false;
+  }
+  SmallVector<InsertPoint_t, 1> EntryPoints;
+  if (LiveIn) {
+    EntryPoints.emplace_back(Preheader, Preheader->getFirstTerminator());
+  }
+  const Register NewReg =
+      splitRegion(
+          LI.reg(),
+          [&](const MachineBasicBlock &MBB) { return L.contains(&MBB); },
+          EntryPoints, ExitPoints)
+          .first;
+  LLVM_DEBUG(dbgs() << "Splitting " << printReg(NewReg, RA->TRI)
+                    << " around loop " << printMBBReference(*L.getHeader())
+                    << "\n");
+  ++NumLoopSplits;
+  return true;
+}
+
+bool RAIntfGraph::IntfGraph::splitAroundBlocks(LiveInterval &LI) {
+  const Register Reg = LI.reg();
+  SmallSetVector<MachineBasicBlock *, 8> UseBlocks;
+  for (MachineInstr &MI : RA->MRI->reg_nodbg_instructions(Reg)) {
+    UseBlocks.insert(MI.getParent());
+  }
+  // The blocks where the register is live beyond its own uses are split at
+  // once, each of them becoming a separate component of the new register.
+  // Splitting them one after another would lose track of the uses in the
+  // later blocks, which a component of the remainder may have taken over.
+  SmallPtrSet<const MachineBasicBlock *, 8> Region;
+  SmallVector<InsertPoint_t, 8> EntryPoints, ExitPoints;
+  for (MachineBasicBlock *const MBB : UseBlocks) {
+    const bool LiveIn = RA->LIS->isLiveInToMBB(LI, MBB);
+    // Only a value defined in the block needs to be copied back, otherwise
+    // the register still holds it.
+    const bool LiveOut =
+        RA->LIS->isLiveOutOfMBB(LI, MBB) &&
+        any_of(RA->MRI->def_instructions(Reg), [&](const MachineInstr &MI) {
+          return MI.getParent() == MBB;
+        });
+    if ((!LiveIn && !LiveOut) || MBB->isEHPad() ||
+        any_of(MBB->terminators(),
+               [&](const MachineInstr &MI) {
+                 return MI.modifiesRegister(Reg, RA->TRI);
+               }) ||
+        !isColorableIn(Reg, MBB)) {
+      continue;
+    }
+    Region.insert(MBB);
+    if (LiveIn) {
+      EntryPoints.emplace_back(MBB, MBB->SkipPHIsLabelsAndDebug(MBB->begin()));
+    }
+    if (LiveOut) {
+      ExitPoints.emplace_back(MBB, MBB->getFirstTerminator());
+    }
+  }
+  if (Region.empty()) {
+    return false;
+  }
+  splitRegion(
+      Reg,
+      [&](const MachineBasicBlock &MBB) { return Region.count(&MBB) != 0; },
+      EntryPoints, ExitPoints);
+  LLVM_DEBUG(dbgs() << "Splitting " << printReg(Reg, RA->TRI)
+                    << " around its uses in " << Region.size()
+                    << " block(s)\n");
+  ++NumBlockSplits;
+  return true;
+}
+
+bool RAIntfGraph::IntfGraph::trySplit(LiveInterval &LI) {
+  const MachineBasicBlock *HottestMBB = nullptr;
+  double HottestFreq = -1;
+  for (const MachineInstr &MI : RA->MRI->reg_nodbg_instructions(LI.reg())) {
+    const double Freq =
+        RA->MBFI->getBlockFreqRelativeToEntryBlock(MI.getParent());
+    if (Freq > HottestFreq) {
+      HottestMBB = MI.getParent();
+      HottestFreq = Freq;
+    }
+  }
+  if (!HottestMBB) {
+    return false;
+  }
+  for (MachineLoop *L = RA->MLI->getLoopFor(HottestMBB); L;
+       L = L->getParentLoop()) {
+    if (splitAroundLoop(LI, *L)) {
+      return true;
+    }
+  }
+  return splitAroundBlocks(LI);
+}
 
 RAIntfGraph::IntfGraph::MaterializeResult_t
 RAIntfGraph::IntfGraph::tryMaterializeAllInternal() {
-  std::unordered_map<LiveInterval *, MCPhysReg> PhysRegAssignment;
-
-  //@TODO(cscd70) Please implement this method.
-  // ∀r ∈ IntfRels.keys, try to materialize it. If successful, cache it in
-  // PhysRegAssignment, else mark it as to be spilled.
-  bool failToMaterialize = false;
-  LiveInterval *toBeSpilled = nullptr;
-  while (!IntfRels.empty() && !failToMaterialize) { //
-	outs() << "Hi\n";
-	auto it_toBePopped = IntfRels.begin(); // the node with highest weight
-	LiveInterval *toBePopped = (*it_toBePopped).first;
-	erase(toBePopped->reg());	
-
-	// invalidate cached interference queries
-	// after modifying virtual register live ranges
-	RA->LRM->invalidateVirtRegs();	
-	
-	SmallVector<Register, 4> SplitVirtRegs;
-	MCRegister PhysReg = selectOrSplit(toBePopped, &SplitVirtRegs);
-
-	if (PhysReg) {
-	  RA->LRM->assign(*toBePopped, PhysReg);
-	  PhysRegAssignment.emplace(toBePopped, PhysReg);
-	} else {
-	  toBeSpilled = toBePopped;
-	  failToMaterialize = true;
-	}
+  SmallVector<unsigned, 4> Files;
+  for (unsigned File = 0; File < IntfRels.size(); ++File) {
+    for (const Register Reg : IntfRels[File].regs()) {
+      prepareSelect(RA->LIS->getInterval(Reg));
+    }
+    if (!IntfRels[File].empty()) {
+      Files.push_back(File);
+    }
+  }
+  std::vector<std::vector<Register>> Selected(IntfRels.size());
+  std::vector<std::string> Logs(IntfRels.size());
+  forEachFile(Files, [&](const unsigned File) {
+    raw_string_ostream OS(Logs[File]);
+    Selected[File] = colorFile(File, OS);
+  });
 
-	for (Register Reg : SplitVirtRegs) {
-	  LiveInterval *LI = &RA->LIS->getInterval(Reg);
-	  if (RA->MRI->reg_nodbg_empty(LI->reg())) {
-		RA->LIS->removeInterval(LI->reg());
-		continue;
-	  }
-	  insert(Reg);
-	}
+  // Assign the colors in the order of the files and of the selection, which
+  // does not depend on the scheduling of the threads.
+  std::unordered_map<LiveInterval *, MCPhysReg> PhysRegAssignment;
+  SmallVector<LiveInterval *, 4> Uncolored;
+  unsigned NumPotentialSpills = 0;
+  for (const unsigned File : Files) {
+    outs() << Logs[File];
+    for (const Register &Reg : Selected[File]) {
+      LiveInterval *const LI = &RA->LIS->getInterval(Reg);
+      // logged here rather than by the threads simplifying the files
+      if (getNode(Reg).Degree >= getNumColors(Reg)) {
+        LLVM_DEBUG(dbgs() << "Potential spill {Reg=" << *LI << "}\n");
+        ++NumPotentialSpills;
+      }
+      if (const MCPhysReg PhysReg = getNode(Reg).Color) {
+        RA->LRM->assign(*LI, PhysReg);
+        PhysRegAssignment.emplace(LI, PhysReg);
+      } else {
+        Uncolored.push_back(LI);
+      }
+    }
+  }
+  SetVector<LiveInterval *> Spills;
+  for (LiveInterval *const LI : Uncolored) {
+    collectSpills(LI, Spills);
+  }
+  if (Spills.empty()) {
+    NumOptimistic += NumPotentialSpills;
+    return std::make_tuple(SmallVector<LiveInterval *, 4>(), PhysRegAssignment);
   }
-  return std::make_tuple(toBeSpilled, PhysRegAssignment);
+  return std::make_tuple(
+      SmallVector<LiveInterval *, 4>(Spills.begin(), Spills.end()),
+      std::unordered_map<LiveInterval *, MCPhysReg>());
 }
 
 void RAIntfGraph::IntfGraph::tryMaterializeAll() {
-  std::unordered_map<LiveInterval *, MCPhysReg> PhysRegAssignment;
   /**
    * @TODO(cscd70) Please implement this method.
    */
   // Keep looping until a valid assignment is made. In the case of spilling,
   // modify the interference graph accordingly. 
-  bool finish = false;
-  while (!finish) {
-	auto internalResult = tryMaterializeAllInternal();
-	LiveInterval *toBeSpilled = std::get<LiveInterval*>(internalResult);
-	auto &tmpAssignment = std::get<std::unordered_map<LiveInterval*, MCPhysReg>>(internalResult);
-	for (const auto &search : tmpAssignment) {
-		assignedPhysReg.emplace(search.second);
-		PhysRegAssignment.emplace(search.first, search.second);
-	}
-	if (toBeSpilled == nullptr) {
-	  finish = true; 
-	}
-  } 
+  while (true) {
+    const SmallVector<LiveInterval *, 4> Spills =
+        std::get<0>(tryMaterializeAllInternal());
+    if (Spills.empty()) {
+      break;
+    }
+    for (LiveInterval *const LI : Spills) {
+      // spilling an earlier one may have left this one empty
+      if (LI->empty()) {
+        continue;
+      }
+      // an interference of a register that cannot be spilled
+      if (RA->VRM->hasPhys(LI->reg())) {
+        evict(*LI);
+      }
+      if (!SplitRegs.count(LI->reg()) && trySplit(*LI)) {
+        continue;
+      }
+      LLVM_DEBUG(dbgs() << "Spilling {Reg=" << *LI << "}\n");
+      SmallVector<Register, 4> SplitVirtRegs;
+      RA->spill(*LI, *RA, SplitVirtRegs);
+    }
+    // Only the registers left without one, i.e., those created or changed by
+    // the spills and the splits and those whose interferences were spilled
+    // instead, are inserted and colored again, while the others keep their
+    // registers and their nodes.
+    SmallVector<Register, 16> VirtRegs;
+    for (unsigned VirtRegIdx = 0; VirtRegIdx < RA->MRI->getNumVirtRegs();
+         ++VirtRegIdx) {
+      const Register VirtReg = Register::index2VirtReg(VirtRegIdx);
+      if (RA->MRI->reg_nodbg_empty(VirtReg) ||
+          !RA->LIS->hasInterval(VirtReg) || RA->VRM->hasPhys(VirtReg)) {
+        continue;
+      }
+      VirtRegs.push_back(VirtReg);
+    }
+    RA->LRM->invalidateVirtRegs();
+    insert(VirtRegs);
+  }
+}
+
+/**
+ * @brief Linear scan register allocator, for the builds where compile time
+ *        matters more than the quality of the code.
+ *
+ * The live intervals are visited in the order of their starts, without any
+ * graph. The active list holds the assigned intervals that cover the current
+ * start, and those that end before it are dropped as the scan moves on. An
+ * interval takes the first of its hints that is free in @c LiveRegMatrix ,
+ * which also accounts for the holes of the intervals. Otherwise, the interval
+ * that ends last, among itself and the active ones that would leave it a
+ * register, is spilled (Poletto and Sarkar), and the intervals left by the
+ * spill join the scan.
+ */
+class RALinearScan final : public RABase, private LiveRangeEdit::Delegate {
+private:
+  using Entry_t = std::pair<SlotIndex, Register>;
+  /// Intervals still to be visited, the earliest start on top, ties broken by
+  /// the register number
+  std::priority_queue<Entry_t, std::vector<Entry_t>, std::greater<Entry_t>>
+      Unhandled;
+  /// Assigned intervals that cover the current start
+  std::vector<LiveInterval *> Active;
+
+  void enqueue(const Register &Reg) {
+    if (!LIS->hasInterval(Reg)) {
+      return;
+    }
+    const LiveInterval &LI = LIS->getInterval(Reg);
+    Unhandled.emplace(LI.empty() ? SI->getZeroIndex() : LI.beginIndex(), Reg);
+  }
+  void assign(LiveInterval &LI, const MCPhysReg PhysReg) {
+    LRM->assign(LI, PhysReg);
+    if (!LI.empty()) {
+      Active.push_back(&LI);
+    }
+  }
+  void unassign(LiveInterval &LI) {
+    LRM->unassign(LI);
+    erase_if(Active, [&](LiveInterval *const ActiveLI) {
+      return ActiveLI == &LI;
+    });
+  }
+  /**
+   * @brief Spill @c LI and add the intervals left by the spill to the scan.
+   */
+  void spillAndEnqueue(LiveInterval &LI) {
+    LLVM_DEBUG(dbgs() << "Spilling {Reg=" << LI << "}\n");
+    SmallVector<Register, 4> NewRegs;
+    spill(LI, *this, NewRegs);
+    for (const Register &NewReg : NewRegs) {
+      enqueue(NewReg);
+    }
+    LRM->invalidateVirtRegs();
+  }
+  /**
+   * @brief Spill an active interval that ends after @c LI and whose register
+   *        would then be free for @c LI , the one that ends last.
+   *
+   * @return The register freed for @c LI , or 0 if there is none
+   */
+  MCPhysReg spillActive(LiveInterval &LI, AllocationHints &AH);
+  /**
+   * @brief Spill the interferences of @c LI , which cannot be spilled itself,
+   *        on the first of its registers where they all can be.
+   *
+   * @return The register freed for @c LI
+   */
+  MCPhysReg spillInterferences(LiveInterval &LI, AllocationHints &AH);
+  void allocate(LiveInterval &LI);
+
+  /// The following two methods are inherited from @c LiveRangeEdit::Delegate
+  /// and implicitly used by the spiller to edit the live ranges.
+  bool LRE_CanEraseVirtReg(Register Reg) override {
+    LiveInterval &LI = LIS->getInterval(Reg);
+    if (!VRM->hasPhys(Reg)) {
+      // still to be visited, after which it is dropped
+      LI.clear();
+      return false;
+    }
+    unassign(LI);
+    return true;
+  }
+  void LRE_WillShrinkVirtReg(Register Reg) override {
+    if (!VRM->hasPhys(Reg)) {
+      return;
+    }
+    unassign(LIS->getInterval(Reg));
+    enqueue(Reg);
+  }
+
+public:
+  static char ID;
+
+  StringRef getPassName() const override {
+    return "Linear Scan Register Allocator";
+  }
 
-  for (auto &PhysRegAssignPair : PhysRegAssignment) {
-    RA->LRM->assign(*PhysRegAssignPair.first, PhysRegAssignPair.second);
+  RALinearScan() : RABase(ID) {}
+
+  bool runOnMachineFunction(MachineFunction &MF) override;
+}; // class RALinearScan
+
+MCPhysReg RALinearScan::spillActive(LiveInterval &LI, AllocationHints &AH) {
+  std::vector<LiveInterval *> Candidates = Active;
+  llvm::stable_sort(Candidates, [](const LiveInterval *const LHS,
+                                   const LiveInterval *const RHS) {
+    return LHS->endIndex() > RHS->endIndex();
+  });
+  for (LiveInterval *const ActiveLI : Candidates) {
+    if (!LI.empty() && ActiveLI->endIndex() <= LI.endIndex()) {
+      break;
+    }
+    const MCPhysReg PhysReg = VRM->getPhys(ActiveLI->reg());
+    if (!ActiveLI->isSpillable() || !is_contained(AH, PhysReg)) {
+      continue;
+    }
+    LRM->unassign(*ActiveLI);
+    // other intervals may share the register in the holes of this one
+    if (LRM->checkInterference(LI, PhysReg) != LiveRegMatrix::IK_Free) {
+      LRM->assign(*ActiveLI, PhysReg);
+      continue;
+    }
+    erase_if(Active, [&](const LiveInterval *const Other) {
+      return Other == ActiveLI;
+    });
+    spillAndEnqueue(*ActiveLI);
+    return PhysReg;
+  }
+  return 0;
+}
+
+MCPhysReg RALinearScan::spillInterferences(LiveInterval &LI,
+                                           AllocationHints &AH) {
+  for (const MCPhysReg PhysReg : AH) {
+    if (LRM->checkInterference(LI, PhysReg) != LiveRegMatrix::IK_VirtReg) {
+      continue;
+    }
+    SmallSetVector<LiveInterval *, 4> IntfLIs;
+    for (MCRegUnitIterator Units(PhysReg, TRI); Units.isValid(); ++Units) {
+      LiveIntervalUnion::Query &Q = LRM->query(LI, *Units);
+      Q.collectInterferingVRegs();
+      IntfLIs.insert(Q.interferingVRegs().begin(),
+                     Q.interferingVRegs().end());
+    }
+    if (!all_of(IntfLIs, [](LiveInterval *const IntfLI) {
+          return IntfLI->isSpillable();
+        })) {
+      continue;
+    }
+    for (LiveInterval *const IntfLI : IntfLIs) {
+      unassign(*IntfLI);
+    }
+    for (LiveInterval *const IntfLI : IntfLIs) {
+      spillAndEnqueue(*IntfLI);
+    }
+    return PhysReg;
+  }
+  report_fatal_error("ran out of registers during register allocation");
+}
+
+void RALinearScan::allocate(LiveInterval &LI) {
+  AllocationHints AH(this, &LI);
+  for (const MCPhysReg PhysReg : AH) {
+    if (LRM->checkInterference(LI, PhysReg) == LiveRegMatrix::IK_Free) {
+      assign(LI, PhysReg);
+      return;
+    }
+  }
+  if (!LI.isSpillable()) {
+    assign(LI, spillInterferences(LI, AH));
+    return;
+  }
+  if (const MCPhysReg PhysReg = spillActive(LI, AH)) {
+    assign(LI, PhysReg);
+    return;
   }
+  spillAndEnqueue(LI);
+}
+
+bool RALinearScan::runOnMachineFunction(MachineFunction &MF) {
+  init(MF);
+  for (unsigned VirtRegIdx = 0; VirtRegIdx < MRI->getNumVirtRegs();
+       ++VirtRegIdx) {
+    const Register VirtReg = Register::index2VirtReg(VirtRegIdx);
+    if (!MRI->reg_nodbg_empty(VirtReg)) {
+      enqueue(VirtReg);
+    }
+  }
+  while (!Unhandled.empty()) {
+    const SlotIndex Start = Unhandled.top().first;
+    const Register Reg = Unhandled.top().second;
+    Unhandled.pop();
+    // erased by the spiller, or visited again after a shrink
+    if (!LIS->hasInterval(Reg) || VRM->hasPhys(Reg)) {
+      continue;
+    }
+    if (MRI->reg_nodbg_empty(Reg)) {
+      LIS->removeInterval(Reg);
+      continue;
+    }
+    erase_if(Active, [&](const LiveInterval *const ActiveLI) {
+      return ActiveLI->endIndex() <= Start;
+    });
+    allocate(LIS->getInterval(Reg));
+  }
+  Active.clear();
+
+  postOptimization();
+  reportSpillCode();
+  return true;
 }
 
 char RAIntfGraph::ID = 0;
+char RALinearScan::ID = 0;
 
 static RegisterRegAlloc X("intfgraph", "Interference Graph Register Allocator",
                           []() -> FunctionPass * { return new RAIntfGraph(); });
+static RegisterRegAlloc Y("linearscan", "Linear Scan Register Allocator",
+                          []() -> FunctionPass * { return new RALinearScan(); });
 
 } // anonymous namespace
 
@@ -537,3 +2254,17 @@ INITIALIZE_PASS_DEPENDENCY(MachineLoopInfo);
 INITIALIZE_PASS_DEPENDENCY(MachineBlockFrequencyInfo);
 INITIALIZE_PASS_END(RAIntfGraph, "regallointfgraph",
                     "Interference Graph Register Allocator", false, false)
+
+INITIALIZE_PASS_BEGIN(RALinearScan, "regallolinearscan",
+                      "Linear Scan Register Allocator", false, false)
+INITIALIZE_PASS_DEPENDENCY(SlotIndexes)
+INITIALIZE_PASS_DEPENDENCY(VirtRegMap)
+INITIALIZE_PASS_DEPENDENCY(LiveIntervals)
+INITIALIZE_PASS_DEPENDENCY(LiveRegMatrix)
+INITIALIZE_PASS_DEPENDENCY(LiveStacks);
+INITIALIZE_PASS_DEPENDENCY(AAResultsWrapperPass);
+INITIALIZE_PASS_DEPENDENCY(MachineDominatorTree);
+INITIALIZE_PASS_DEPENDENCY(MachineLoopInfo);
+INITIALIZE_PASS_DEPENDENCY(MachineBlockFrequencyInfo);
+INITIALIZE_PASS_END(RALinearScan, "regallolinearscan",
+                    "Linear Scan Register Allocator", false, false)
@@ -0,0 +1,253 @@
+#pragma once // NOLINT(llvm-header-guard)
+
+/**
+ * @file Register Pressure Estimation of Loops
+ */
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/Analysis/LoopInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/IR/Instructions.h>
+
+#include <algorithm>
+#include <climits>
+
+using namespace llvm;
+
+/**
+ * @brief Estimate of the register pressure of a loop, i.e., the maximum number
+ *        of values of each register class that are live at the same time.
+ *
+ * The values defined outside the loop and used inside are live throughout the
+ * loop. The liveness of the ones defined inside is computed over the CFG of
+ * the loop, back edges included, where the incoming values of a phi are live
+ * at the end of the corresponding predecessor. Every value is assumed to take
+ * a register of its own, as there is no way of telling at this level which
+ * ones the instruction selection folds away.
+ */
+class LoopRegPressure {
+private:
+  using ValueSet = SmallPtrSet<const Value *, 16>;
+
+  const Loop &L;
+  const TargetTransformInfo &TTI;
+  /// Values live throughout the loop
+  ValueSet LiveThrough;
+  /// Maximum number of live values per register class
+  DenseMap<unsigned, unsigned> MaxLive;
+
+  static bool needsReg(const Value *const V) {
+    if (!isa<Instruction>(V) && !isa<Argument>(V)) {
+      return false;
+    }
+    // static allocas are accessed relative to the frame
+    if (const AllocaInst *const Alloca = dyn_cast<AllocaInst>(V)) {
+      if (Alloca->isStaticAlloca()) {
+        return false;
+      }
+    }
+    return V->getType()->isFirstClassType() && !V->getType()->isVoidTy() &&
+           !V->getType()->isTokenTy() && !V->getType()->isLabelTy();
+  }
+  bool isDefinedInside(const Value *const V) const {
+    const Instruction *const Inst = dyn_cast<Instruction>(V);
+    return Inst && L.contains(Inst);
+  }
+  /// Whether @c Op is live throughout the loop only for the sake of @c Inst
+  bool isFreedByHoisting(const Value *const Op,
+                         const Instruction &Inst) const {
+    if (!LiveThrough.count(Op)) {
+      return false;
+    }
+    for (const User *const U : Op->users()) {
+      if (U != &Inst && L.contains(cast<Instruction>(U))) {
+        return false;
+      }
+    }
+    return true;
+  }
+  /**
+   * @brief Walk @c BB backward from @c Live (the values live at its end),
+   *        which is left with the values live at its beginning.
+   *
+   * @param Counts  Number of live values per register class, updated along
+   *                with @c Live and whose maximum is recorded
+   */
+  void walkBackward(const BasicBlock &BB, ValueSet &Live,
+                    DenseMap<unsigned, unsigned> *const Counts) {
+    auto Update = [&](const Value *const V, const bool Insert) {
+      if (!(Insert ? Live.insert(V).second : Live.erase(V)) || !Counts) {
+        return;
+      }
+      unsigned &Count = (*Counts)[getRegClass(*V)];
+      Count = Insert ? Count + 1 : Count - 1;
+      MaxLive[getRegClass(*V)] =
+          std::max(MaxLive[getRegClass(*V)], Count);
+    };
+    for (const Instruction &Inst : reverse(BB)) {
+      Update(&Inst, false);
+      if (isa<PHINode>(Inst)) {
+        continue;
+      }
+      for (const Value *const Op : Inst.operands()) {
+        if (needsReg(Op) && isDefinedInside(Op)) {
+          Update(Op, true);
+        }
+      }
+    }
+  }
+
+public:
+  LoopRegPressure(const Loop &L, const TargetTransformInfo &TTI)
+      : L(L), TTI(TTI) {
+    // the values defined inside and live into some exit block
+    ValueSet LiveOut;
+    for (const BasicBlock *const BB : L.getBlocks()) {
+      for (const Instruction &Inst : *BB) {
+        for (const Use &U : Inst.operands()) {
+          const PHINode *const PHI = dyn_cast<PHINode>(&Inst);
+          if (needsReg(U) && !isDefinedInside(U) &&
+              !(PHI && !L.contains(PHI->getIncomingBlock(U)))) {
+            LiveThrough.insert(U);
+          }
+        }
+        for (const User *const U : Inst.users()) {
+          if (needsReg(&Inst) && !L.contains(cast<Instruction>(U))) {
+            LiveOut.insert(&Inst);
+          }
+        }
+      }
+    }
+
+    // Iterate the (backward) liveness to a fixpoint. Visiting the blocks in
+    // the reverse of the loop order, which starts at the header, makes it
+    // converge within a few rounds.
+    DenseMap<const BasicBlock *, ValueSet> LiveIns;
+    auto ComputeLiveOut = [&](const BasicBlock &BB) {
+      ValueSet Live;
+      for (const BasicBlock *const Succ : successors(&BB)) {
+        if (!L.contains(Succ)) {
+          Live.insert(LiveOut.begin(), LiveOut.end());
+          continue;
+        }
+        const ValueSet &SuccLiveIn = LiveIns[Succ];
+        Live.insert(SuccLiveIn.begin(), SuccLiveIn.end());
+        for (const PHINode &PHI : Succ->phis()) {
+          const Value *const V = PHI.getIncomingValueForBlock(&BB);
+          if (needsReg(V) && isDefinedInside(V)) {
+            Live.insert(V);
+          }
+        }
+      }
+      return Live;
+    };
+    for (bool Changed = true; Changed;) {
+      Changed = false;
+      for (const BasicBlock *const BB : reverse(L.getBlocks())) {
+        ValueSet Live = ComputeLiveOut(*BB);
+        walkBackward(*BB, Live, nullptr);
+        ValueSet &LiveIn = LiveIns[BB];
+        if (Live.size() != LiveIn.size()) {
+          LiveIn = std::move(Live);
+          Changed = true;
+        }
+      }
+    }
+
+    DenseMap<unsigned, unsigned> LiveThroughCounts;
+    for (const Value *const V : LiveThrough) {
+      ++LiveThroughCounts[getRegClass(*V)];
+    }
+    for (const BasicBlock *const BB : L.getBlocks()) {
+      ValueSet Live = ComputeLiveOut(*BB);
+      DenseMap<unsigned, unsigned> Counts = LiveThroughCounts;
+      for (const Value *const V : Live) {
+        ++Counts[getRegClass(*V)];
+      }
+      for (const auto &ClassCountPair : Counts) {
+        MaxLive[ClassCountPair.first] =
+            std::max(MaxLive[ClassCountPair.first], ClassCountPair.second);
+      }
+      walkBackward(*BB, Live, &Counts);
+    }
+  }
+
+  unsigned getRegClass(const Value &V) const {
+    return TTI.getRegisterClassForType(V.getType()->isVectorTy(),
+                                       V.getType());
+  }
+  unsigned getMaxLive(const unsigned ClassID) const {
+    return MaxLive.lookup(ClassID);
+  }
+  unsigned getNumRegs(const unsigned ClassID) const {
+    return TTI.getNumberOfRegisters(ClassID);
+  }
+  /**
+   * @brief Check whether @c V could be kept live throughout the loop without
+   *        exceeding the registers of its class.
+   */
+  bool hasRoomFor(const Value &V) const {
+    const unsigned ClassID = getRegClass(V);
+    return getMaxLive(ClassID) < getNumRegs(ClassID);
+  }
+  /**
+   * @brief Check whether the registers would still suffice after hoisting
+   *        @c Inst out of the loop, which makes it live throughout the loop
+   *        but may end the live ranges of its operands before the loop.
+   */
+  bool hasRoomToHoist(const Instruction &Inst) const {
+    const unsigned ClassID = getRegClass(Inst);
+    unsigned NumFreed = 0;
+    for (const Value *const Op : Inst.operands()) {
+      if (isFreedByHoisting(Op, Inst) && getRegClass(*Op) == ClassID) {
+        ++NumFreed;
+      }
+    }
+    return getMaxLive(ClassID) + 1 <= getNumRegs(ClassID) + NumFreed;
+  }
+  /**
+   * @brief Estimate how many copies of the loop body could run side by side,
+   *        e.g., after unrolling, without exceeding the registers.
+   *
+   * The copies share the values live throughout the loop, while each of them
+   * needs registers of its own for the rest.
+   */
+  unsigned getMaxCopies() const {
+    DenseMap<unsigned, unsigned> LiveThroughCounts;
+    for (const Value *const V : LiveThrough) {
+      ++LiveThroughCounts[getRegClass(*V)];
+    }
+    unsigned MaxCopies = UINT_MAX;
+    for (const auto &ClassMaxPair : MaxLive) {
+      const unsigned NumShared = LiveThroughCounts.lookup(ClassMaxPair.first);
+      const unsigned NumRegs = getNumRegs(ClassMaxPair.first);
+      if (ClassMaxPair.second <= NumShared) {
+        continue;
+      }
+      MaxCopies = std::min(MaxCopies, NumRegs > NumShared
+                                          ? (NumRegs - NumShared) /
+                                                (ClassMaxPair.second - NumShared)
+                                          : 0U);
+    }
+    return MaxCopies;
+  }
+  /**
+   * @brief Account for @c V being live throughout the loop from now on.
+   */
+  void addLiveThrough(const Value &V) {
+    if (LiveThrough.insert(&V).second) {
+      ++MaxLive[getRegClass(V)];
+    }
+  }
+  /**
+   * @brief Account for @c Inst having been hoisted out of the loop.
+   */
+  void hoisted(const Instruction &Inst) {
+    for (const Value *const Op : Inst.operands()) {
+      if (isFreedByHoisting(Op, Inst) && LiveThrough.erase(Op)) {
+        --MaxLive[getRegClass(*Op)];
+      }
+    }
+    addLiveThrough(Inst);
+  }
+};
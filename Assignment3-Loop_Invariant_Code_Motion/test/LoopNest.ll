@@ -0,0 +1,54 @@
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-invariant-code-motion %s -o %basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+
+; int nest(int a, int b, int n) {
+;   int s = 0;
+;   for (int i = 0; i < n; ++i) {
+;     for (int j = 0; j < n; ++j) {
+;       s += (a * b + i + j) / 3;
+;     }
+;   }
+;   return s;
+; }
+
+; 'a * b' is invariant in the whole nest and goes straight to the outermost
+; preheader, whereas 'a * b + i' only leaves the inner loop.
+; CHECK-LABEL: define i32 @nest(i32 %0, i32 %1, i32 %2) {
+; CHECK-NEXT:    %4 = mul nsw i32 %0, %1
+; CHECK-NEXT:    br label %5
+; CHECK:         %.01 = phi i32 [ 0, %3 ], [ %.lcssa, %13 ]
+; CHECK-NEXT:    %6 = add nsw i32 %4, %.02
+; CHECK-NEXT:    br label %7
+; CHECK:         %.0 = phi i32 [ 0, %5 ], [ %11, %7 ]
+; CHECK-NEXT:    %8 = add nsw i32 %6, %.0
+; CHECK-NEXT:    %9 = sdiv i32 %8, 3
+define i32 @nest(i32 %0, i32 %1, i32 %2) {
+  br label %4
+
+4:                                                ; preds = %13, %3
+  %.02 = phi i32 [ 0, %3 ], [ %14, %13 ]
+  %.01 = phi i32 [ 0, %3 ], [ %.lcssa, %13 ]
+  br label %5
+
+5:                                                ; preds = %5, %4
+  %.1 = phi i32 [ %.01, %4 ], [ %10, %5 ]
+  %.0 = phi i32 [ 0, %4 ], [ %11, %5 ]
+  %6 = mul nsw i32 %0, %1
+  %7 = add nsw i32 %6, %.02
+  %8 = add nsw i32 %7, %.0
+  %9 = sdiv i32 %8, 3
+  %10 = add nsw i32 %.1, %9
+  %11 = add nsw i32 %.0, 1
+  %12 = icmp slt i32 %11, %2
+  br i1 %12, label %5, label %13
+
+13:                                               ; preds = %5
+  %.lcssa = phi i32 [ %10, %5 ]
+  %14 = add nsw i32 %.02, 1
+  %15 = icmp slt i32 %14, %2
+  br i1 %15, label %4, label %16
+
+16:                                               ; preds = %13
+  ret i32 %.lcssa
+}
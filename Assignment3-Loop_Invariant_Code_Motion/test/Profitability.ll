@@ -0,0 +1,53 @@
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-invariant-code-motion %s -o %basename_t \
+; RUN:     -pass-remarks=loop-invariant-code-motion \
+; RUN:     -pass-remarks-missed=loop-invariant-code-motion 2>%basename_t.log
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t.log \
+; RUN:     --check-prefix=LOG
+
+; LOG:      remark: <unknown>:0:0: hoisting mul out of 1 loop(s)
+; LOG-NEXT: remark: <unknown>:0:0: not hoisting mul as the preheader would not run it less often
+
+; The profile says that the loop of @hot iterates many times, while the one of
+; @cold never goes back to its header, hence hoisting would not save anything.
+; CHECK-LABEL: define i32 @hot(i32 %0, i32 %1, i32 %2) {
+; CHECK-NEXT:    %4 = mul nsw i32 %0, %1
+; CHECK-NEXT:    br label %5
+; CHECK-LABEL: define i32 @cold(i32 %0, i32 %1, i32 %2) {
+; CHECK-NEXT:    br label %4
+; CHECK:         %5 = mul nsw i32 %0, %1
+define i32 @hot(i32 %0, i32 %1, i32 %2) {
+  br label %4
+
+4:                                                ; preds = %4, %3
+  %.01 = phi i32 [ 0, %3 ], [ %6, %4 ]
+  %.0 = phi i32 [ 0, %3 ], [ %7, %4 ]
+  %5 = mul nsw i32 %0, %1
+  %6 = add nsw i32 %.01, %5
+  %7 = add nsw i32 %.0, 1
+  %8 = icmp slt i32 %7, %2
+  br i1 %8, label %4, label %9, !prof !0
+
+9:                                                ; preds = %4
+  ret i32 %6
+}
+
+define i32 @cold(i32 %0, i32 %1, i32 %2) {
+  br label %4
+
+4:                                                ; preds = %4, %3
+  %.01 = phi i32 [ 0, %3 ], [ %6, %4 ]
+  %.0 = phi i32 [ 0, %3 ], [ %7, %4 ]
+  %5 = mul nsw i32 %0, %1
+  %6 = add nsw i32 %.01, %5
+  %7 = add nsw i32 %.0, 1
+  %8 = icmp slt i32 %7, %2
+  br i1 %8, label %4, label %9, !prof !1
+
+9:                                                ; preds = %4
+  ret i32 %6
+}
+
+!0 = !{!"branch_weights", i32 1000, i32 1}
+!1 = !{!"branch_weights", i32 0, i32 1000}
@@ -0,0 +1,64 @@
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-invariant-code-motion -licm-versioning=false %s -o %basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+
+; void accumulate(int *restrict a, int *restrict sum, int n) {
+;   int i = 0;
+;   do {
+;     *sum += *a;
+;   } while (++i < n);
+; }
+
+; '*a' is never written in the loop and is hoisted, while '*sum' is kept in a
+; register and only stored back at the exit.
+; CHECK-LABEL: define void @accumulate(i32* noalias %0, i32* noalias %1, i32 %2) {
+; CHECK-NEXT:    %4 = load i32, i32* %0, align 4
+; CHECK-NEXT:    %.promoted = load i32, i32* %1, align 4
+; CHECK-NEXT:    br label %5
+; CHECK:         %.promoted1 = phi i32 [ %.promoted, %3 ], [ %6, %5 ]
+; CHECK-NEXT:    %.0 = phi i32 [ 0, %3 ], [ %7, %5 ]
+; CHECK-NEXT:    %6 = add nsw i32 %.promoted1, %4
+; CHECK:         store i32 %6, i32* %1, align 4
+; CHECK-NEXT:    ret void
+
+; Without 'restrict' (nor versioning, see Versioning.ll), the store to '*sum'
+; may clobber '*a'.
+; CHECK-LABEL: define void @aliased(i32* %0, i32* %1, i32 %2) {
+; CHECK-NEXT:    br label %4
+; CHECK:         %5 = load i32, i32* %0, align 4
+; CHECK-NEXT:    %6 = load i32, i32* %1, align 4
+; CHECK-NEXT:    %7 = add nsw i32 %6, %5
+; CHECK-NEXT:    store i32 %7, i32* %1, align 4
+define void @accumulate(i32* noalias %0, i32* noalias %1, i32 %2) {
+  br label %4
+
+4:                                                ; preds = %4, %3
+  %.0 = phi i32 [ 0, %3 ], [ %8, %4 ]
+  %5 = load i32, i32* %0, align 4
+  %6 = load i32, i32* %1, align 4
+  %7 = add nsw i32 %6, %5
+  store i32 %7, i32* %1, align 4
+  %8 = add nsw i32 %.0, 1
+  %9 = icmp slt i32 %8, %2
+  br i1 %9, label %4, label %10
+
+10:                                               ; preds = %4
+  ret void
+}
+
+define void @aliased(i32* %0, i32* %1, i32 %2) {
+  br label %4
+
+4:                                                ; preds = %4, %3
+  %.0 = phi i32 [ 0, %3 ], [ %8, %4 ]
+  %5 = load i32, i32* %0, align 4
+  %6 = load i32, i32* %1, align 4
+  %7 = add nsw i32 %6, %5
+  store i32 %7, i32* %1, align 4
+  %8 = add nsw i32 %.0, 1
+  %9 = icmp slt i32 %8, %2
+  br i1 %9, label %4, label %10
+
+10:                                               ; preds = %4
+  ret void
+}
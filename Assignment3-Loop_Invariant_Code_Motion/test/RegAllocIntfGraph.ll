@@ -0,0 +1,274 @@
+; RUN: llc -load %dylibdir/libLICM.so -regalloc=intfgraph -intfgraph-report \
+; RUN:     -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs \
+; RUN:     -join-liveintervals=false %s -o %basename_t.s > %basename_t.log
+; RUN: FileCheck %s --input-file=%basename_t.log --check-prefix=COALESCE
+; RUN: llc -load %dylibdir/libLICM.so -regalloc=intfgraph -intfgraph-report \
+; RUN:     -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs \
+; RUN:     -join-liveintervals=false -intfgraph-coalescing=false \
+; RUN:     %s -o %basename_t.s > %basename_t.log
+; RUN: FileCheck %s --input-file=%basename_t.log --check-prefix=NOCOALESCE
+; RUN: llc -load %dylibdir/libLICM.so -regalloc=intfgraph -intfgraph-report \
+; RUN:     -mtriple=i686-unknown-linux-gnu -verify-machineinstrs \
+; RUN:     %s -o %basename_t.s > %basename_t.log
+; RUN: FileCheck %s --input-file=%basename_t.log --check-prefix=SPLIT
+; RUN: llc -load %dylibdir/libLICM.so -regalloc=intfgraph \
+; RUN:     -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs \
+; RUN:     -intfgraph-threads=1 %s -o %basename_t.1.s
+; RUN: llc -load %dylibdir/libLICM.so -regalloc=intfgraph \
+; RUN:     -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs \
+; RUN:     -intfgraph-threads=4 %s -o %basename_t.4.s
+; RUN: diff %basename_t.1.s %basename_t.4.s
+; RUN: llc -load %dylibdir/libLICM.so -regalloc=intfgraph -intfgraph-report \
+; RUN:     -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs \
+; RUN:     -no-stack-slot-sharing %s -o %basename_t.s > %basename_t.log
+; RUN: FileCheck %s --input-file=%basename_t.log --check-prefix=SLOTS
+; RUN: llc -load %dylibdir/libLICM.so -regalloc=linearscan -intfgraph-report \
+; RUN:     -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs \
+; RUN:     %s -o %basename_t.s > %basename_t.log
+; RUN: FileCheck %s --input-file=%basename_t.log --check-prefix=LINEARSCAN
+; RUN: llc -load %dylibdir/libLICM.so -regalloc=linearscan -intfgraph-report \
+; RUN:     -mtriple=i686-unknown-linux-gnu -verify-machineinstrs \
+; RUN:     %s -o %basename_t.s > %basename_t.log
+; RUN: FileCheck %s --input-file=%basename_t.log --check-prefix=LINEARSCAN32
+; RUN: llc -load %dylibdir/libLICM.so -regalloc=linearscan \
+; RUN:     -mtriple=x86_64-unknown-linux-gnu -verify-machineinstrs %s -o - \
+; RUN:   | FileCheck %s --check-prefix=LINEARSCAN-ASM
+
+; int kernel(int *a, int *b, int n) {
+;   int s0 = 1, ..., s15 = 16;
+;   double f0 = 1.0, ..., f3 = 4.0;
+;   for (int i = 0; i < n; ++i) {
+;     int x = a[i];
+;     s0 += x * s5; s1 ^= x * s6; ...; s15 ^= x * s4;
+;     f0 += x * f1; ...; f3 += x * f0;
+;   }
+;   int p = (int)((f0 + f1) / (f2 + f3)) ^ s0 ^ ... ^ s15;
+;   int t0 = 1, ..., t15 = 16;
+;   for (int i = 0; i < n; ++i) {
+;     int y = b[i] + p;
+;     t0 += y * t5; t1 ^= y * t6; ...; t15 ^= y * t4;
+;   }
+;   return n < 1 ? 0 : t0 ^ ... ^ t15;
+; }
+
+; Each loop keeps 16 accumulators live, more than there are general purpose
+; registers on x86-64. Without the register coalescer of LLVM, the copies of
+; the loop carried values are left to the allocator.
+; COALESCE:   Moves of kernel: 80 coalesced, 283 -> 54 static, 3587.05 -> 936.81 dynamic (relative to the entry block)
+; COALESCE:   Spill code of kernel: 72 stores, 55 reloads, 0 rematerializations
+; NOCOALESCE: Moves of kernel: 0 coalesced, 283 -> 74 static, 3587.05 -> 1187.71 dynamic (relative to the entry block)
+; NOCOALESCE: Spill code of kernel: 81 stores, 52 reloads, 0 rematerializations
+
+; The 7 general purpose registers of i686 hold even fewer of them, so that
+; many are split around their uses in several blocks before being spilled.
+; SPLIT:      Spill code of kernel: 51 stores, 47 reloads, 0 rematerializations
+
+; The integer and the floating point accumulators belong to separate register
+; files, whose graphs come out of the parallel coloring as out of the
+; sequential one.
+
+; The values spilled in the first loop are dead by the second, so their slots
+; are shared even without the stack slot coloring of LLVM.
+; SLOTS:      Spill slots of kernel: 22 -> 13, 36 bytes saved
+
+; The linear scan spills more, having neither the graph nor the splitting.
+; LINEARSCAN:   Spill slots of kernel: 24 -> 14, 40 bytes saved
+; LINEARSCAN:   Spill code of kernel: 30 stores, 40 reloads, 0 rematerializations
+; LINEARSCAN32: Spill slots of kernel: 38 -> 21, 68 bytes saved
+; LINEARSCAN32: Spill code of kernel: 59 stores, 88 reloads, 1 rematerializations
+
+; Without -intfgraph-report, the allocator writes nothing to the output next to
+; the assembly: each line outside of a label, a directive or a comment is an
+; indented instruction.
+; LINEARSCAN-ASM-NOT:   {{^[^[:space:].#][^[:space:]:]*[[:space:]]}}
+; LINEARSCAN-ASM-LABEL: {{^}}kernel:
+; LINEARSCAN-ASM-NOT:   {{^[^[:space:].#][^[:space:]:]*[[:space:]]}}
+; LINEARSCAN-ASM:       .section ".note.GNU-stack"
+define i32 @kernel(i32* %a, i32* %b, i32 %n) {
+entry:
+  %empty = icmp slt i32 %n, 1
+  br i1 %empty, label %exit, label %first
+
+first:
+  %first.i = phi i32 [ 0, %entry ], [ %first.inext, %first ]
+  %s0 = phi i32 [ 1, %entry ], [ %s0.next, %first ]
+  %s1 = phi i32 [ 2, %entry ], [ %s1.next, %first ]
+  %s2 = phi i32 [ 3, %entry ], [ %s2.next, %first ]
+  %s3 = phi i32 [ 4, %entry ], [ %s3.next, %first ]
+  %s4 = phi i32 [ 5, %entry ], [ %s4.next, %first ]
+  %s5 = phi i32 [ 6, %entry ], [ %s5.next, %first ]
+  %s6 = phi i32 [ 7, %entry ], [ %s6.next, %first ]
+  %s7 = phi i32 [ 8, %entry ], [ %s7.next, %first ]
+  %s8 = phi i32 [ 9, %entry ], [ %s8.next, %first ]
+  %s9 = phi i32 [ 10, %entry ], [ %s9.next, %first ]
+  %s10 = phi i32 [ 11, %entry ], [ %s10.next, %first ]
+  %s11 = phi i32 [ 12, %entry ], [ %s11.next, %first ]
+  %s12 = phi i32 [ 13, %entry ], [ %s12.next, %first ]
+  %s13 = phi i32 [ 14, %entry ], [ %s13.next, %first ]
+  %s14 = phi i32 [ 15, %entry ], [ %s14.next, %first ]
+  %s15 = phi i32 [ 16, %entry ], [ %s15.next, %first ]
+  %f0 = phi double [ 1.0, %entry ], [ %f0.next, %first ]
+  %f1 = phi double [ 2.0, %entry ], [ %f1.next, %first ]
+  %f2 = phi double [ 3.0, %entry ], [ %f2.next, %first ]
+  %f3 = phi double [ 4.0, %entry ], [ %f3.next, %first ]
+  %first.p = getelementptr inbounds i32, i32* %a, i32 %first.i
+  %first.x = load i32, i32* %first.p
+  %s0.m = mul i32 %first.x, %s5
+  %s0.next = add i32 %s0, %s0.m
+  %s1.m = mul i32 %first.x, %s6
+  %s1.next = xor i32 %s1, %s1.m
+  %s2.m = mul i32 %first.x, %s7
+  %s2.next = add i32 %s2, %s2.m
+  %s3.m = mul i32 %first.x, %s8
+  %s3.next = xor i32 %s3, %s3.m
+  %s4.m = mul i32 %first.x, %s9
+  %s4.next = add i32 %s4, %s4.m
+  %s5.m = mul i32 %first.x, %s10
+  %s5.next = xor i32 %s5, %s5.m
+  %s6.m = mul i32 %first.x, %s11
+  %s6.next = add i32 %s6, %s6.m
+  %s7.m = mul i32 %first.x, %s12
+  %s7.next = xor i32 %s7, %s7.m
+  %s8.m = mul i32 %first.x, %s13
+  %s8.next = add i32 %s8, %s8.m
+  %s9.m = mul i32 %first.x, %s14
+  %s9.next = xor i32 %s9, %s9.m
+  %s10.m = mul i32 %first.x, %s15
+  %s10.next = add i32 %s10, %s10.m
+  %s11.m = mul i32 %first.x, %s0
+  %s11.next = xor i32 %s11, %s11.m
+  %s12.m = mul i32 %first.x, %s1
+  %s12.next = add i32 %s12, %s12.m
+  %s13.m = mul i32 %first.x, %s2
+  %s13.next = xor i32 %s13, %s13.m
+  %s14.m = mul i32 %first.x, %s3
+  %s14.next = add i32 %s14, %s14.m
+  %s15.m = mul i32 %first.x, %s4
+  %s15.next = xor i32 %s15, %s15.m
+  %first.d = sitofp i32 %first.x to double
+  %f0.m = fmul double %first.d, %f1
+  %f0.next = fadd double %f0, %f0.m
+  %f1.m = fmul double %first.d, %f2
+  %f1.next = fadd double %f1, %f1.m
+  %f2.m = fmul double %first.d, %f3
+  %f2.next = fadd double %f2, %f2.m
+  %f3.m = fmul double %first.d, %f0
+  %f3.next = fadd double %f3, %f3.m
+  %first.inext = add nuw nsw i32 %first.i, 1
+  %first.done = icmp eq i32 %first.inext, %n
+  br i1 %first.done, label %middle, label %first
+
+middle:
+  %f01 = fadd double %f0.next, %f1.next
+  %f23 = fadd double %f2.next, %f3.next
+  %f = fdiv double %f01, %f23
+  %fi = fptosi double %f to i32
+  %p0 = xor i32 %fi, %s0.next
+  %p1 = xor i32 %p0, %s1.next
+  %p2 = xor i32 %p1, %s2.next
+  %p3 = xor i32 %p2, %s3.next
+  %p4 = xor i32 %p3, %s4.next
+  %p5 = xor i32 %p4, %s5.next
+  %p6 = xor i32 %p5, %s6.next
+  %p7 = xor i32 %p6, %s7.next
+  %p8 = xor i32 %p7, %s8.next
+  %p9 = xor i32 %p8, %s9.next
+  %p10 = xor i32 %p9, %s10.next
+  %p11 = xor i32 %p10, %s11.next
+  %p12 = xor i32 %p11, %s12.next
+  %p13 = xor i32 %p12, %s13.next
+  %p14 = xor i32 %p13, %s14.next
+  %p15 = xor i32 %p14, %s15.next
+  br label %second
+
+second:
+  %second.i = phi i32 [ 0, %middle ], [ %second.inext, %second ]
+  %t0 = phi i32 [ 1, %middle ], [ %t0.next, %second ]
+  %t1 = phi i32 [ 2, %middle ], [ %t1.next, %second ]
+  %t2 = phi i32 [ 3, %middle ], [ %t2.next, %second ]
+  %t3 = phi i32 [ 4, %middle ], [ %t3.next, %second ]
+  %t4 = phi i32 [ 5, %middle ], [ %t4.next, %second ]
+  %t5 = phi i32 [ 6, %middle ], [ %t5.next, %second ]
+  %t6 = phi i32 [ 7, %middle ], [ %t6.next, %second ]
+  %t7 = phi i32 [ 8, %middle ], [ %t7.next, %second ]
+  %t8 = phi i32 [ 9, %middle ], [ %t8.next, %second ]
+  %t9 = phi i32 [ 10, %middle ], [ %t9.next, %second ]
+  %t10 = phi i32 [ 11, %middle ], [ %t10.next, %second ]
+  %t11 = phi i32 [ 12, %middle ], [ %t11.next, %second ]
+  %t12 = phi i32 [ 13, %middle ], [ %t12.next, %second ]
+  %t13 = phi i32 [ 14, %middle ], [ %t13.next, %second ]
+  %t14 = phi i32 [ 15, %middle ], [ %t14.next, %second ]
+  %t15 = phi i32 [ 16, %middle ], [ %t15.next, %second ]
+  %second.p = getelementptr inbounds i32, i32* %b, i32 %second.i
+  %second.v = load i32, i32* %second.p
+  %second.x = add i32 %second.v, %p15
+  %t0.m = mul i32 %second.x, %t5
+  %t0.next = add i32 %t0, %t0.m
+  %t1.m = mul i32 %second.x, %t6
+  %t1.next = xor i32 %t1, %t1.m
+  %t2.m = mul i32 %second.x, %t7
+  %t2.next = add i32 %t2, %t2.m
+  %t3.m = mul i32 %second.x, %t8
+  %t3.next = xor i32 %t3, %t3.m
+  %t4.m = mul i32 %second.x, %t9
+  %t4.next = add i32 %t4, %t4.m
+  %t5.m = mul i32 %second.x, %t10
+  %t5.next = xor i32 %t5, %t5.m
+  %t6.m = mul i32 %second.x, %t11
+  %t6.next = add i32 %t6, %t6.m
+  %t7.m = mul i32 %second.x, %t12
+  %t7.next = xor i32 %t7, %t7.m
+  %t8.m = mul i32 %second.x, %t13
+  %t8.next = add i32 %t8, %t8.m
+  %t9.m = mul i32 %second.x, %t14
+  %t9.next = xor i32 %t9, %t9.m
+  %t10.m = mul i32 %second.x, %t15
+  %t10.next = add i32 %t10, %t10.m
+  %t11.m = mul i32 %second.x, %t0
+  %t11.next = xor i32 %t11, %t11.m
+  %t12.m = mul i32 %second.x, %t1
+  %t12.next = add i32 %t12, %t12.m
+  %t13.m = mul i32 %second.x, %t2
+  %t13.next = xor i32 %t13, %t13.m
+  %t14.m = mul i32 %second.x, %t3
+  %t14.next = add i32 %t14, %t14.m
+  %t15.m = mul i32 %second.x, %t4
+  %t15.next = xor i32 %t15, %t15.m
+  %second.inext = add nuw nsw i32 %second.i, 1
+  %second.done = icmp eq i32 %second.inext, %n
+  br i1 %second.done, label %exit, label %second
+
+exit:
+  %r0 = phi i32 [ 0, %entry ], [ %t0.next, %second ]
+  %r1 = phi i32 [ 0, %entry ], [ %t1.next, %second ]
+  %r2 = phi i32 [ 0, %entry ], [ %t2.next, %second ]
+  %r3 = phi i32 [ 0, %entry ], [ %t3.next, %second ]
+  %r4 = phi i32 [ 0, %entry ], [ %t4.next, %second ]
+  %r5 = phi i32 [ 0, %entry ], [ %t5.next, %second ]
+  %r6 = phi i32 [ 0, %entry ], [ %t6.next, %second ]
+  %r7 = phi i32 [ 0, %entry ], [ %t7.next, %second ]
+  %r8 = phi i32 [ 0, %entry ], [ %t8.next, %second ]
+  %r9 = phi i32 [ 0, %entry ], [ %t9.next, %second ]
+  %r10 = phi i32 [ 0, %entry ], [ %t10.next, %second ]
+  %r11 = phi i32 [ 0, %entry ], [ %t11.next, %second ]
+  %r12 = phi i32 [ 0, %entry ], [ %t12.next, %second ]
+  %r13 = phi i32 [ 0, %entry ], [ %t13.next, %second ]
+  %r14 = phi i32 [ 0, %entry ], [ %t14.next, %second ]
+  %r15 = phi i32 [ 0, %entry ], [ %t15.next, %second ]
+  %q1 = xor i32 %r0, %r1
+  %q2 = xor i32 %q1, %r2
+  %q3 = xor i32 %q2, %r3
+  %q4 = xor i32 %q3, %r4
+  %q5 = xor i32 %q4, %r5
+  %q6 = xor i32 %q5, %r6
+  %q7 = xor i32 %q6, %r7
+  %q8 = xor i32 %q7, %r8
+  %q9 = xor i32 %q8, %r9
+  %q10 = xor i32 %q9, %r10
+  %q11 = xor i32 %q10, %r11
+  %q12 = xor i32 %q11, %r12
+  %q13 = xor i32 %q12, %r13
+  %q14 = xor i32 %q13, %r14
+  %q15 = xor i32 %q14, %r15
+  ret i32 %q15
+}
@@ -0,0 +1,76 @@
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-invariant-code-motion %s -o %basename_t \
+; RUN:     -pass-remarks-missed=loop-invariant-code-motion 2>%basename_t.log
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t.log \
+; RUN:     --check-prefix=LOG
+
+; Each product of the arguments is invariant, but the arguments remain live
+; throughout the loop, so every hoisted product takes one more of the 16
+; general purpose registers of x86-64. The ones beyond that are left in the
+; loop rather than spilled.
+; LOG-COUNT-4: remark: <unknown>:0:0: not hoisting mul: it is cheap enough to be left in the loop, and hoisting it would exceed the 16 registers of its class
+
+; CHECK-LABEL: define i32 @kernel(i32 %a0, i32 %a1, i32 %a2, i32 %a3, i32 %a4, i32 %a5, i32 %n) {
+; CHECK-NEXT:  entry:
+; CHECK-NEXT:    %p0 = mul i32 %a0, %a1
+; CHECK-NEXT:    %p1 = mul i32 %a0, %a2
+; CHECK-NEXT:    %p2 = mul i32 %a0, %a3
+; CHECK-NEXT:    %p3 = mul i32 %a0, %a4
+; CHECK-NEXT:    %p4 = mul i32 %a0, %a5
+; CHECK-NEXT:    br label %loop
+; CHECK:         %p5 = mul i32 %a1, %a2
+; CHECK:         %p6 = mul i32 %a1, %a3
+; CHECK:         %p7 = mul i32 %a1, %a4
+; CHECK:         %p8 = mul i32 %a1, %a5
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @kernel(i32 %a0, i32 %a1, i32 %a2, i32 %a3, i32 %a4, i32 %a5, i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %p0 = mul i32 %a0, %a1
+  %t0 = xor i32 %p0, %acc
+  %s0 = add i32 %acc, %t0
+  %p1 = mul i32 %a0, %a2
+  %t1 = xor i32 %p1, %acc
+  %s1 = add i32 %s0, %t1
+  %p2 = mul i32 %a0, %a3
+  %t2 = xor i32 %p2, %acc
+  %s2 = add i32 %s1, %t2
+  %p3 = mul i32 %a0, %a4
+  %t3 = xor i32 %p3, %acc
+  %s3 = add i32 %s2, %t3
+  %p4 = mul i32 %a0, %a5
+  %t4 = xor i32 %p4, %acc
+  %s4 = add i32 %s3, %t4
+  %p5 = mul i32 %a1, %a2
+  %t5 = xor i32 %p5, %acc
+  %s5 = add i32 %s4, %t5
+  %p6 = mul i32 %a1, %a3
+  %t6 = xor i32 %p6, %acc
+  %s6 = add i32 %s5, %t6
+  %p7 = mul i32 %a1, %a4
+  %t7 = xor i32 %p7, %acc
+  %s7 = add i32 %s6, %t7
+  %p8 = mul i32 %a1, %a5
+  %t8 = xor i32 %p8, %acc
+  %s8 = add i32 %s7, %t8
+  %x0 = xor i32 %s8, %a0
+  %x1 = xor i32 %x0, %a1
+  %x2 = xor i32 %x1, %a2
+  %x3 = xor i32 %x2, %a3
+  %x4 = xor i32 %x3, %a4
+  %x5 = xor i32 %x4, %a5
+  %acc.next = xor i32 %x5, %i
+  %i.next = add i32 %i, 1
+  %cmp = icmp slt i32 %i.next, %n
+  br i1 %cmp, label %loop, label %exit
+
+exit:
+  ret i32 %acc.next
+}
@@ -0,0 +1,46 @@
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-invariant-code-motion %s -o %basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+
+; The multiplication is only used after the loop and gets a copy in each of
+; the exits, which also replaces the LCSSA phi. The invariant addition does
+; not dominate the first exit and cannot be hoisted, but it can be sunk into
+; the second one.
+; CHECK-LABEL: define i32 @sink(i32 %0, i32 %1) {
+; CHECK:         %.0 = phi i32 [ 0, %2 ], [ %6, %5 ]
+; CHECK-NEXT:    %4 = icmp eq i32 %.0, %1
+; CHECK-NEXT:    br i1 %4, label %8, label %5
+; CHECK:         %6 = add nsw i32 %.0, 1
+; CHECK-NEXT:    %7 = icmp slt i32 %6, 100
+; CHECK-NEXT:    br i1 %7, label %3, label %10
+; CHECK:         %9 = mul nsw i32 %.0, %0
+; CHECK-NEXT:    ret i32 %9
+; CHECK:         %11 = mul nsw i32 %.0, %0
+; CHECK-NEXT:    %12 = add nsw i32 %0, %1
+; CHECK-NEXT:    %13 = add nsw i32 %11, %12
+; CHECK-NEXT:    %14 = sub nsw i32 %13, %6
+; CHECK-NEXT:    ret i32 %14
+define i32 @sink(i32 %0, i32 %1) {
+  br label %3
+
+3:                                                ; preds = %6, %2
+  %.0 = phi i32 [ 0, %2 ], [ %8, %6 ]
+  %4 = mul nsw i32 %.0, %0
+  %5 = icmp eq i32 %.0, %1
+  br i1 %5, label %10, label %6
+
+6:                                                ; preds = %3
+  %7 = add nsw i32 %0, %1
+  %8 = add nsw i32 %.0, 1
+  %9 = icmp slt i32 %8, 100
+  br i1 %9, label %3, label %11
+
+10:                                               ; preds = %3
+  %.lcssa = phi i32 [ %4, %3 ]
+  ret i32 %.lcssa
+
+11:                                               ; preds = %6
+  %12 = add nsw i32 %4, %7
+  %13 = sub nsw i32 %12, %8
+  ret i32 %13
+}
@@ -0,0 +1,102 @@
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-strength-reduction %s -o %basename_t \
+; RUN:     -pass-remarks=loop-strength-reduction 2>%basename_t.log
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t.log \
+; RUN:     --check-prefix=LOG
+
+; LOG:      remark: <unknown>:0:0: replaced mul with an induction variable
+; LOG-NEXT: remark: <unknown>:0:0: replaced getelementptr with an induction variable
+; LOG-NOT:  remark:
+
+; int scale(int a, int n) {
+;   int s = 0, i = 0;
+;   do {
+;     s += i * a;
+;   } while (++i < n);
+;   return s;
+; }
+; The product advances by a on every iteration.
+; CHECK-LABEL: define i32 @scale(i32 %0, i32 %1) {
+; CHECK:         %sr = phi i32 [ 0, %2 ], [ %sr.next, %3 ]
+; CHECK-NEXT:    %.0 = phi i32 [ 0, %2 ], [ %5, %3 ]
+; CHECK-NEXT:    %s = phi i32 [ 0, %2 ], [ %4, %3 ]
+; CHECK-NEXT:    %4 = add nsw i32 %s, %sr
+; CHECK-NEXT:    %5 = add nsw i32 %.0, 1
+; CHECK-NEXT:    %6 = icmp slt i32 %5, %1
+; CHECK-NEXT:    %sr.next = add i32 %sr, %0
+; CHECK-NEXT:    br i1 %6, label %3, label %7
+define i32 @scale(i32 %0, i32 %1) {
+  br label %3
+
+3:                                                ; preds = %3, %2
+  %.0 = phi i32 [ 0, %2 ], [ %6, %3 ]
+  %s = phi i32 [ 0, %2 ], [ %5, %3 ]
+  %4 = mul nsw i32 %.0, %0
+  %5 = add nsw i32 %s, %4
+  %6 = add nsw i32 %.0, 1
+  %7 = icmp slt i32 %6, %1
+  br i1 %7, label %3, label %8
+
+8:                                                ; preds = %3
+  ret i32 %5
+}
+
+; void stride(int *a, long stride, long n) {
+;   long i = 0;
+;   do {
+;     a[i * stride] = i;
+;   } while (++i < n);
+; }
+; The address is reduced as a whole, which also removes the multiplication of
+; its index. The pointer advances by the stride in bytes.
+; CHECK-LABEL: define void @stride(i32* %0, i64 %1, i64 %2) {
+; CHECK-NEXT:    %4 = shl i64 %1, 2
+; CHECK-NEXT:    br label %5
+; CHECK:         %sr = phi i32* [ %0, %3 ], [ %sr.next, %5 ]
+; CHECK-NEXT:    %.0 = phi i64 [ 0, %3 ], [ %7, %5 ]
+; CHECK-NEXT:    %6 = trunc i64 %.0 to i32
+; CHECK-NEXT:    store i32 %6, i32* %sr, align 4
+; CHECK-NEXT:    %7 = add nsw i64 %.0, 1
+; CHECK-NEXT:    %8 = icmp slt i64 %7, %2
+; CHECK-NEXT:    %9 = bitcast i32* %sr to i8*
+; CHECK-NEXT:    %10 = getelementptr i8, i8* %9, i64 %4
+; CHECK-NEXT:    %sr.next = bitcast i8* %10 to i32*
+; CHECK-NEXT:    br i1 %8, label %5, label %11
+define void @stride(i32* %0, i64 %1, i64 %2) {
+  br label %4
+
+4:                                                ; preds = %4, %3
+  %.0 = phi i64 [ 0, %3 ], [ %8, %4 ]
+  %5 = mul nsw i64 %.0, %1
+  %6 = getelementptr inbounds i32, i32* %0, i64 %5
+  %7 = trunc i64 %.0 to i32
+  store i32 %7, i32* %6, align 4
+  %8 = add nsw i64 %.0, 1
+  %9 = icmp slt i64 %8, %2
+  br i1 %9, label %4, label %10
+
+10:                                               ; preds = %4
+  ret void
+}
+
+; An address indexed by the induction variable itself is left to the
+; addressing modes.
+; CHECK-LABEL: define void @direct(i32* %0, i64 %1) {
+; CHECK-NOT:     %sr
+; CHECK:         %4 = getelementptr inbounds i32, i32* %0, i64 %.0
+define void @direct(i32* %0, i64 %1) {
+  br label %3
+
+3:                                                ; preds = %3, %2
+  %.0 = phi i64 [ 0, %2 ], [ %6, %3 ]
+  %4 = getelementptr inbounds i32, i32* %0, i64 %.0
+  %5 = trunc i64 %.0 to i32
+  store i32 %5, i32* %4, align 4
+  %6 = add nsw i64 %.0, 1
+  %7 = icmp slt i64 %6, %1
+  br i1 %7, label %3, label %8
+
+8:                                                ; preds = %3
+  ret void
+}
@@ -0,0 +1,110 @@
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-unrolling %s -o %basename_t \
+; RUN:     -pass-remarks=loop-unrolling \
+; RUN:     -pass-remarks-missed=loop-unrolling 2>%basename_t.log
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t.log \
+; RUN:     --check-prefix=LOG
+
+; LOG:      remark: <unknown>:0:0: completely unrolled a loop of 4 iterations
+; LOG-NEXT: remark: <unknown>:0:0: reducing the unrolling factor from 8 to 5 due to register pressure
+; LOG-NEXT: remark: <unknown>:0:0: unrolled a loop by a factor of 4
+; LOG-NEXT: remark: <unknown>:0:0: reducing the unrolling factor from 8 to 4 due to register pressure
+; LOG-NEXT: remark: <unknown>:0:0: unrolled a loop by a factor of 4 with a remainder loop
+
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+; int full(int *a) {
+;   int s = 0;
+;   for (long i = 0; i < 4; ++i)
+;     s += a[i];
+;   return s;
+; }
+; The four iterations are small enough to become straight-line code.
+; CHECK-LABEL: define i32 @full(i32* %0) {
+; CHECK-NEXT:    br label %2
+; CHECK:         %3 = load i32, i32* %0, align 4
+; CHECK-NEXT:    %4 = getelementptr inbounds i32, i32* %0, i64 1
+; CHECK-NEXT:    %5 = load i32, i32* %4, align 4
+; CHECK-NEXT:    %6 = add nsw i32 %3, %5
+; CHECK-NEXT:    %7 = getelementptr inbounds i32, i32* %0, i64 2
+; CHECK-NEXT:    %8 = load i32, i32* %7, align 4
+; CHECK-NEXT:    %9 = add nsw i32 %6, %8
+; CHECK-NEXT:    %10 = getelementptr inbounds i32, i32* %0, i64 3
+; CHECK-NEXT:    %11 = load i32, i32* %10, align 4
+; CHECK-NEXT:    %12 = add nsw i32 %9, %11
+; CHECK-NEXT:    ret i32 %12
+define i32 @full(i32* %0) {
+  br label %2
+
+2:                                                ; preds = %2, %1
+  %.0 = phi i64 [ 0, %1 ], [ %6, %2 ]
+  %s = phi i32 [ 0, %1 ], [ %5, %2 ]
+  %3 = getelementptr inbounds i32, i32* %0, i64 %.0
+  %4 = load i32, i32* %3, align 4
+  %5 = add nsw i32 %s, %4
+  %6 = add nuw nsw i64 %.0, 1
+  %7 = icmp ult i64 %6, 4
+  br i1 %7, label %2, label %8
+
+8:                                                ; preds = %2
+  ret i32 %5
+}
+
+; The same loop with 64 iterations would be too large to unroll fully. The
+; copies of the body must fit in the registers next to each other, which
+; allows for 4 of them, and 64 is a multiple of 4.
+; CHECK-LABEL: define i32 @multiple(i32* %0) {
+; CHECK:         %.0 = phi i64 [ 0, %1 ], [ %18, %2 ]
+; CHECK:         %14 = add nuw nsw i64 %10, 1
+; CHECK-NEXT:    %15 = getelementptr inbounds i32, i32* %0, i64 %14
+; CHECK-NEXT:    %16 = load i32, i32* %15, align 4
+; CHECK-NEXT:    %17 = add nsw i32 %13, %16
+; CHECK-NEXT:    %18 = add nuw nsw i64 %14, 1
+; CHECK-NEXT:    %19 = icmp ult i64 %18, 64
+; CHECK-NEXT:    br i1 %19, label %2, label %20, !llvm.loop ![[#DISABLE:]]
+define i32 @multiple(i32* %0) {
+  br label %2
+
+2:                                                ; preds = %2, %1
+  %.0 = phi i64 [ 0, %1 ], [ %6, %2 ]
+  %s = phi i32 [ 0, %1 ], [ %5, %2 ]
+  %3 = getelementptr inbounds i32, i32* %0, i64 %.0
+  %4 = load i32, i32* %3, align 4
+  %5 = add nsw i32 %s, %4
+  %6 = add nuw nsw i64 %.0, 1
+  %7 = icmp ult i64 %6, 64
+  br i1 %7, label %2, label %8
+
+8:                                                ; preds = %2
+  ret i32 %5
+}
+
+; With an unknown trip count, the unrolled loop runs n / 4 times and a
+; remainder loop the other n % 4 iterations.
+; CHECK-LABEL: define i32 @partial(i32* %0, i64 %1) {
+; CHECK:         %xtraiter = and i64 %umax, 3
+; CHECK:         %unroll_iter = sub i64 %umax, %xtraiter
+; CHECK:         %niter.ncmp.3 = icmp ne i64 %niter.next.3, %unroll_iter
+; CHECK:         %epil.iter.cmp = icmp ne i64 %epil.iter.next, %xtraiter
+define i32 @partial(i32* %0, i64 %1) {
+  br label %3
+
+3:                                                ; preds = %3, %2
+  %.0 = phi i64 [ 0, %2 ], [ %7, %3 ]
+  %s = phi i32 [ 0, %2 ], [ %6, %3 ]
+  %4 = getelementptr inbounds i32, i32* %0, i64 %.0
+  %5 = load i32, i32* %4, align 4
+  %6 = add nsw i32 %s, %5
+  %7 = add nuw nsw i64 %.0, 1
+  %8 = icmp ult i64 %7, %1
+  br i1 %8, label %3, label %9
+
+9:                                                ; preds = %3
+  ret i32 %6
+}
+
+; The unrolled loop is not unrolled again.
+; CHECK: ![[#DISABLE]] = distinct !{![[#DISABLE]], ![[#UNROLL_DISABLE:]]}
+; CHECK: ![[#UNROLL_DISABLE]] = !{!"llvm.loop.unroll.disable"}
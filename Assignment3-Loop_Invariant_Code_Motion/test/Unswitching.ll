@@ -0,0 +1,150 @@
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-invariant-code-motion %s -o %basename_t \
+; RUN:     -pass-remarks=loop-invariant-code-motion 2>%basename_t.log
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t.log \
+; RUN:     --check-prefix=LOG
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-invariant-code-motion %s -o /dev/null \
+; RUN:     -licm-unswitch-max-growth=10 \
+; RUN:     -pass-remarks-missed=loop-invariant-code-motion 2>%basename_t.budget.log
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t.budget.log \
+; RUN:     --check-prefix=BUDGET
+; RUN: opt -load %dylibdir/libLICM.so -loop-invariant-code-motion \
+; RUN:     -verify-dom-info -domtree -analyze %s -o %basename_t.dom
+; RUN: FileCheck %s --input-file=%basename_t.dom --check-prefix=DOM
+
+; LOG:      remark: <unknown>:0:0: unswitched an exit of the loop
+; LOG-NEXT: remark: <unknown>:0:0: hoisting icmp out of 1 loop(s)
+; LOG-NEXT: remark: <unknown>:0:0: unswitched the loop, duplicating 11 instructions
+; BUDGET:   remark: <unknown>:0:0: not unswitching a loop of 11 instructions as it exceeds the code growth budget
+
+; int trivial(int n, bool stop) {
+;   int s = 0;
+;   for (int i = 0; !stop; ) {
+;     s += i;
+;     if (++i >= n) return s;
+;   }
+;   return s;
+; }
+
+; The exit is taken in the first iteration or never, hence can be decided
+; before the loop without duplicating it.
+; CHECK-LABEL: define i32 @trivial(i32 %0, i1 %1) {
+; CHECK-NEXT:    br i1 %1, label %8, label %.split
+; CHECK:         %.01 = phi i32 [ 0, %.split ], [ %5, %4 ]
+; CHECK-NEXT:    %.0 = phi i32 [ 0, %.split ], [ %6, %4 ]
+; CHECK-NEXT:    br label %4
+; CHECK:         %.lcssa = phi i32 [ 0, %2 ]
+; CHECK-NEXT:    ret i32 %.lcssa
+
+; int nontrivial(int n, int add, int unused) {
+;   int s = 0;
+;   for (int i = 0; i < n; ++i)
+;     s = add ? s + i : s - i;
+;   return s;
+; }
+
+; The loop gets a copy for each value of 'add', and the branch inside either
+; copy is left with a constant condition.
+; CHECK-LABEL: define i32 @nontrivial(i32 %0, i32 %1, i32 %2) {
+; CHECK-NEXT:    %4 = icmp ne i32 %1, 0
+; CHECK-NEXT:    br i1 %4, label %.split, label %.split.us
+; CHECK:         br i1 false, label %7, label %6
+; CHECK:         br i1 %11, label %5, label %.loopexit1
+; CHECK:         br i1 true, label %13, label %15
+; CHECK:         br i1 %18, label %12, label %.loopexit
+; CHECK:         %.1.lcssa = phi i32 [ %.1.lcssa.ph, %.loopexit ], [ %.1.lcssa.ph2, %.loopexit1 ]
+; CHECK-NEXT:    ret i32 %.1.lcssa
+
+; int merged(int n, bool stop) {
+;   int r = -1;
+;   for (int i = 0; !stop; )
+;     if (++i >= n) { r = i; break; }
+;   return r;
+; }
+
+; The unswitched exit meets the other one in %9, which is then dominated by
+; the check before the loop rather than by the loop.
+; CHECK-LABEL: define i32 @merged(i32 %0, i1 %1) {
+; CHECK-NEXT:    br i1 %1, label %7, label %.split
+; CHECK:         %.1 = phi i32 [ -1, %7 ], [ %.lcssa, %8 ]
+; CHECK-NEXT:    ret i32 %.1
+; DOM-LABEL: function 'merged':
+; DOM:         [1] %2
+; DOM-DAG:       [2] %9
+; DOM-DAG:       [2] %7
+; DOM-DAG:       [2] %.split
+; DOM-DAG:         [3] %3
+define i32 @trivial(i32 %0, i1 %1) {
+  br label %3
+
+3:                                                ; preds = %4, %2
+  %.01 = phi i32 [ 0, %2 ], [ %5, %4 ]
+  %.0 = phi i32 [ 0, %2 ], [ %6, %4 ]
+  br i1 %1, label %8, label %4
+
+4:                                                ; preds = %3
+  %5 = add nsw i32 %.01, %.0
+  %6 = add nsw i32 %.0, 1
+  %7 = icmp slt i32 %6, %0
+  br i1 %7, label %3, label %9
+
+8:                                                ; preds = %3
+  %.lcssa = phi i32 [ %.01, %3 ]
+  ret i32 %.lcssa
+
+9:                                               ; preds = %4
+  ret i32 %5
+}
+
+define i32 @nontrivial(i32 %0, i32 %1, i32 %2) {
+  br label %4
+
+4:                                                ; preds = %9, %3
+  %.01 = phi i32 [ 0, %3 ], [ %.1, %9 ]
+  %.0 = phi i32 [ 0, %3 ], [ %10, %9 ]
+  %5 = icmp ne i32 %1, 0
+  br i1 %5, label %6, label %8
+
+6:                                                ; preds = %4
+  %7 = add nsw i32 %.01, %.0
+  br label %9
+
+8:                                                ; preds = %4
+  %.neg = sub i32 %.01, %.0
+  br label %9
+
+9:                                                ; preds = %8, %6
+  %.1 = phi i32 [ %7, %6 ], [ %.neg, %8 ]
+  %10 = add nsw i32 %.0, 1
+  %11 = icmp slt i32 %10, %0
+  br i1 %11, label %4, label %12
+
+12:                                               ; preds = %9
+  ret i32 %.1
+}
+
+define i32 @merged(i32 %0, i1 %1) {
+  br label %3
+
+3:                                                ; preds = %4, %2
+  %.0 = phi i32 [ 0, %2 ], [ %5, %4 ]
+  br i1 %1, label %7, label %4
+
+4:                                                ; preds = %3
+  %5 = add nsw i32 %.0, 1
+  %6 = icmp slt i32 %5, %0
+  br i1 %6, label %3, label %8
+
+7:                                                ; preds = %3
+  br label %9
+
+8:                                                ; preds = %4
+  %.lcssa = phi i32 [ %5, %4 ]
+  br label %9
+
+9:                                                ; preds = %8, %7
+  %.1 = phi i32 [ -1, %7 ], [ %.lcssa, %8 ]
+  ret i32 %.1
+}
@@ -0,0 +1,106 @@
+; RUN: opt -S -load %dylibdir/libLICM.so \
+; RUN:     -loop-invariant-code-motion %s -o %basename_t \
+; RUN:     -pass-remarks=loop-invariant-code-motion \
+; RUN:     -pass-remarks-missed=loop-invariant-code-motion 2>%basename_t.log
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t
+; RUN: FileCheck --match-full-lines %s --input-file=%basename_t.log \
+; RUN:     --check-prefix=LOG
+
+; void kernel(int *a, int *b, int *s, int n) {
+;   int i = 0;
+;   do {
+;     *s += a[i] * *b;
+;   } while (++i < n);
+; }
+
+; LOG:      remark: <unknown>:0:0: versioned loop with 2 runtime alias check(s)
+; LOG-NEXT: remark: <unknown>:0:0: hoisting load out of 1 loop(s)
+; LOG-NEXT: remark: <unknown>:0:0: versioned loop with 2 runtime alias check(s)
+; LOG-NEXT: remark: <unknown>:0:0: hoisting load out of 1 loop(s)
+; LOG-NEXT: remark: <unknown>:0:0: hoisting mul out of 1 loop(s)
+; LOG-NEXT: remark: <unknown>:0:0: hoisting mul out of 1 loop(s)
+; LOG-NOT:  remark: {{.*}}
+
+; The loop is entered through the runtime checks that 's' overlaps neither 'a'
+; nor 'b'. Should one of them fail, the original loop runs.
+; CHECK-LABEL: define void @kernel(i32* %0, i32* %1, i32* %2, i32 %3) {
+; CHECK-NEXT:  .lver.check:
+; CHECK:         br i1 %conflict.rdx, label %.ph.lver.orig, label %.ph
+; CHECK:         %13 = load i32, i32* %12, align 4
+; CHECK-NEXT:    %14 = load i32, i32* %1, align 4
+; CHECK-NEXT:    %15 = mul nsw i32 %13, %14
+; CHECK-NEXT:    %16 = load i32, i32* %2, align 4
+; CHECK-NEXT:    %17 = add nsw i32 %16, %15
+; CHECK-NEXT:    store i32 %17, i32* %2, align 4
+; Otherwise, '*b' is hoisted and '*s' is promoted.
+; CHECK:       .ph:{{.*}}
+; CHECK-NEXT:    %20 = load i32, i32* %1, align 4, !alias.scope !2
+; CHECK-NEXT:    %.promoted = load i32, i32* %2, align 4
+; CHECK-NEXT:    br label %21
+; CHECK:         %.promoted10 = phi i32 [ %.promoted, %.ph ], [ %26, %21 ]
+; CHECK:         %24 = load i32, i32* %23, align 4, !alias.scope !5
+; CHECK-NEXT:    %25 = mul nsw i32 %24, %20
+; CHECK-NEXT:    %26 = add nsw i32 %.promoted10, %25
+; CHECK:       .loopexit9:{{.*}}
+; CHECK-NEXT:    store i32 %26, i32* %2, align 4
+define void @kernel(i32* %0, i32* %1, i32* %2, i32 %3) {
+  br label %5
+
+5:                                                ; preds = %5, %4
+  %.0 = phi i32 [ 0, %4 ], [ %13, %5 ]
+  %6 = sext i32 %.0 to i64
+  %7 = getelementptr inbounds i32, i32* %0, i64 %6
+  %8 = load i32, i32* %7, align 4
+  %9 = load i32, i32* %1, align 4
+  %10 = mul nsw i32 %8, %9
+  %11 = load i32, i32* %2, align 4
+  %12 = add nsw i32 %11, %10
+  store i32 %12, i32* %2, align 4
+  %13 = add nsw i32 %.0, 1
+  %14 = icmp slt i32 %13, %3
+  br i1 %14, label %5, label %15
+
+15:                                               ; preds = %5
+  ret void
+}
+
+; void scaled(int *a, int *b, int *s, int n) {
+;   int i = 0;
+;   do {
+;     *s += n * n + a[i] * *b;
+;   } while (++i < n);
+; }
+
+; The original loop keeps the frequencies it had before versioning, so 'n * n'
+; is hoisted out of it as well.
+; CHECK-LABEL: define void @scaled(i32* %0, i32* %1, i32* %2, i32 %3) {
+; CHECK:       .ph.lver.orig:{{.*}}
+; CHECK-NEXT:    %10 = mul nsw i32 %3, %3
+; CHECK-NEXT:    br label %11
+; CHECK:       .ph:{{.*}}
+; CHECK-NEXT:    %22 = load i32, i32* %1, align 4, !alias.scope !9
+; CHECK-NEXT:    %23 = mul nsw i32 %3, %3
+; Neither version is versioned again.
+; CHECK:       !1 = !{!"llvm.loop.licm_versioning.disable", i32 1}
+define void @scaled(i32* %0, i32* %1, i32* %2, i32 %3) {
+  br label %5
+
+5:                                                ; preds = %5, %4
+  %.0 = phi i32 [ 0, %4 ], [ %15, %5 ]
+  %6 = sext i32 %.0 to i64
+  %7 = getelementptr inbounds i32, i32* %0, i64 %6
+  %8 = load i32, i32* %7, align 4
+  %9 = load i32, i32* %1, align 4
+  %10 = mul nsw i32 %8, %9
+  %11 = load i32, i32* %2, align 4
+  %12 = mul nsw i32 %3, %3
+  %13 = add nsw i32 %11, %12
+  %14 = add nsw i32 %13, %10
+  store i32 %14, i32* %2, align 4
+  %15 = add nsw i32 %.0, 1
+  %16 = icmp slt i32 %15, %3
+  br i1 %16, label %5, label %17
+
+17:                                               ; preds = %5
+  ret void
+}